@@ -11,6 +11,52 @@
  *                   tiles from top to bottom
  *        11/17/13 - heuristics function working.  game mode 2 and 3 working
  *                   test results for 2 and 3 written.
+ *        10/17/26 - GameState board stored as X and O bit planes. Pattern
+ *                   starts and generated tiles found with shifted planes.
+ *        10/17/26 - Line scores kept in GameState and updated on set(), so
+ *                   heuristics_func only rescores the lines through a move.
+ *        10/17/26 - alphabeta makes and unmakes moves on one board instead
+ *                   of generating a copy of the board for every move.
+ *        10/17/26 - Zobrist keys and a transposition table for alphabeta.
+ *                   --tt and --bench command line options.
+ *        10/17/26 - Move ordering: table move, wins, blocks, killers, history.
+ *        10/17/26 - Threat space search (VCF/VCT) before alphabeta, --tss.
+ *        10/17/26 - Lazy SMP: --threads helper threads share a lock free
+ *                   transposition table, --smp-bench.
+ *        10/17/26 - TimeManager: monotonic clock read every 1024 nodes, soft
+ *                   and hard limits, predicted iteration times.
+ *        10/17/26 - Root moves ordered by the last iteration's scores, a cut
+ *                   off iteration's best move is kept.
+ *        10/17/26 - Line patterns scored from base 3 window tables.
+ *        10/17/26 - Whole board SIMD kernel (AVX2/SSE4.2/scalar, picked by
+ *                   CPUID), --kernel-bench.
+ *        10/17/26 - Search templated on board size and m, 15x15 and 19x19
+ *                   with m = 5 compiled as constants.
+ *        10/17/26 - Moves generated into a fixed size MoveList on the stack,
+ *                   --radius 1 or 2.
+ *        10/17/26 - SearchStats collected for every move, --stats and
+ *                   --stats-json.
+ *        10/17/26 - --match tournaments between 2 engine settings, games
+ *                   played in parallel from paired random openings.
+ *        10/17/26 - --protocol: Gomocup protocol on stdin/stdout, INFO limits
+ *                   set the time per move and the table size.
+ *        10/17/26 - --ponder: search the expected reply on the opponent's time.
+ *        10/17/26 - Principal variation search and aspiration windows.
+ *        10/17/26 - alphabeta in negamax form with a triangular PV table,
+ *                   ctx.pv and --pv.
+ *        10/17/26 - Late move reductions, and a threat filter that only searches
+ *                   wins or blocks when the opponent has a four.
+ *        10/17/26 - Monte Carlo tree search engine, --engine mcts: node pool,
+ *                   heuristic rollouts, tree kept between moves, threads
+ *                   sharing one tree with virtual loss.
+ *        10/17/26 - Empty tiles kept in GameState for O(1) random moves,
+ *                   xoshiro256** generators seeded per game and thread, --seed.
+ *        10/17/26 - Opening book mapped from a file, keyed by the least key of
+ *                   the 8 symmetries, --book, --build-book, --match --record.
+ *        10/17/26 - Keys of the 8 board symmetries kept in GameState, table
+ *                   keyed by the least of them, symmetric root moves dropped.
+ *        10/17/26 - Proof number solver (df-pn) tried first on small boards,
+ *                   --solver, --solve, --solve-report.
  * Resources: en.wikipedia.org/wiki/Alpha–beta_pruning
  *            http://library.thinkquest.org/18242/data/resources/gomoku.pdf
  *
@@ -25,13 +71,25 @@
  */
 #include <iostream>
 #include <vector>
-#include <queue>
 #include <utility>
-#include <set>
 #include <ctime>
 #include <cstdlib>
 #include <string>
 #include <sstream>
+#include <fstream>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define MIN_BOARD_LIMIT 3
 #define MAX_BOARD_LIMIT 19
@@ -58,7 +116,365 @@
 #define SCORE_STRAIGHT_M 4096
 #define SCORE_OPP_STRAIGHT_M -4096
 //default score for any line pattern over 1 is the size of the line pattern
+//Bitboards store one bit per tile, so every row of the board has to fit a word
+#define ROW_BITS 32
+
+/* Shifts a bit plane (one word per row, bit c = column c) by dr rows and dc
+ * columns into dst.  Tiles shifted off the board are dropped, so combining
+ * shifted planes with & and | gives line and neighbor queries without any
+ * per tile branching.
+ */
+void shift_plane(const uint32_t *src, uint32_t *dst, unsigned int n, int dr, int dc) {
+	uint32_t row_mask = (n >= ROW_BITS) ? 0xFFFFFFFFu : ((1u << n) - 1);
+	for (int r = 0; r < (int)n; r++) {
+		int from = r - dr;
+		uint32_t bits = 0;
+		if (from >= 0 && from < (int)n) {
+			bits = src[from];
+			if (dc > 0)
+				bits <<= dc;
+			else if (dc < 0)
+				bits >>= -dc;
+		}
+		dst[r] = bits & row_mask;
+	}
+}
+
+/* Spreads every tile of a bit plane to all tiles within radius rows and
+ * columns of it (the OR of all shifted copies of the plane) into dst.  N is
+ * the board size when it is known at compile time, 0 to use n
+ */
+template <unsigned int N=0>
+void dilate_plane(const uint32_t *src, uint32_t *dst, unsigned int board_n, unsigned int radius) {
+	const unsigned int n = N ? N : board_n;
+	uint32_t row_mask = (n >= ROW_BITS) ? 0xFFFFFFFFu : ((1u << n) - 1);
+	uint32_t spread[MAX_BOARD_LIMIT];
+	for (unsigned int r = 0; r < n; r++) {
+		uint32_t bits = src[r];
+		for (unsigned int k = 1; k <= radius; k++)
+			bits |= (src[r] << k) | (src[r] >> k);
+		spread[r] = bits & row_mask;
+	}
+	for (int r = 0; r < (int)n; r++) {
+		uint32_t bits = 0;
+		for (int k = -(int)radius; k <= (int)radius; k++) {
+			if (r+k >= 0 && r+k < (int)n)
+				bits |= spread[r+k];
+		}
+		dst[r] = bits;
+	}
+}
+
+//Number of lines kept per direction, diagonals need 2n-1 lines
+#define MAX_LINES (2*MAX_BOARD_LIMIT-1)
+//Line directions, in the order heuristics_func checks them
+#define DIR_DOWN 0
+#define DIR_RIGHT 1
+#define DIR_TOPR 2
+#define DIR_BOTR 3
+
+/* Scores a single line pattern that is not exactly m long, the same way
+ * heuristics_func does.
+ * Preconditions: size = length of the pattern, m = # of tiles to match,
+ *                own = true if the pattern belongs to the scoring player,
+ *                diagonal = true if the pattern is on a diagonal line,
+ *                empty_count = # of empty tiles right before and after it,
+ *                m_tiles = true if a tile 2 before or 2 after is empty
+ * Postconditions: Returns the score of the pattern
+ */
+constexpr int pattern_score(unsigned int size, unsigned int m, bool own, bool diagonal,
+	int empty_count, bool m_tiles) {
+	if (size > m)
+		return own ? SCORE_OVER : SCORE_OPP_OVER;
+	if (size == (m-1)) {
+		if (empty_count == 1)
+			return own ? SCORE_M : SCORE_OPP_M;
+		if (empty_count == 2)
+			return own ? SCORE_STRAIGHT_M : SCORE_OPP_STRAIGHT_M;
+		return own ? SCORE_DEADEND : SCORE_OPP_DEADEND;
+	}
+	if (size == (m-2)) {
+		//the diagonal checks have always added the size of an opponent's
+		//pattern here, kept so the scores stay the same
+		if (empty_count == 1)
+			return (own || diagonal) ? (int)size : -(int)size;
+		if (empty_count == 2 && m_tiles)
+			return own ? SCORE_M_MINUS : SCORE_OPP_M_MINUS;
+		return own ? SCORE_DEADEND : SCORE_OPP_DEADEND;
+	}
+	return own ? (int)size : -(int)size;
+}
+
+//Largest m whose patterns are scored from a table, the table has 3^(m+3)
+//entries so longer m walk the runs of a line instead
+#define PATTERN_TABLE_MAX_M 7
+
+//Score of the run starting at the third tile of a pattern window
+struct PatternEntry {
+	//added to the score of the run's player and of the other player
+	int16_t own;
+	int16_t opp;
+	//1 if the run is exactly m long
+	uint8_t win;
+};
+
+/* Scores the window with base 3 index index: m+3 tiles along a line, 2 tiles
+ * before the start of a run of the player's pieces and m+1 tiles from its
+ * start, which is all pattern_score looks at.  Each tile is 0 for empty, 1
+ * for the player's piece and 2 for the other player's piece or a tile off the
+ * board, the first tile being the lowest digit.
+ * Postconditions: Returns the run's entry, all 0 if the window does not start
+ *                 a run
+ */
+constexpr PatternEntry pattern_entry(unsigned int m, bool diagonal, uint32_t index) {
+	int tile[PATTERN_TABLE_MAX_M+3] = {};
+	unsigned int window = m + 3;
+	for (unsigned int k = 0; k < window; k++) {
+		tile[k] = index % 3;
+		index /= 3;
+	}
+	PatternEntry entry = {0, 0, 0};
+	if (tile[2] != 1 || tile[1] == 1)
+		return entry;
+	unsigned int size = 0;
+	while (2+size < window && tile[2+size] == 1)
+		size++;
+	if (size == m) {
+		entry.win = 1;
+		return entry;
+	}
+	int empty_count = (tile[1] == 0) + (size < m && tile[2+size] == 0);
+	bool m_tiles = tile[0] == 0 || (size < m && tile[3+size] == 0);
+	entry.own = pattern_score(size, m, true, diagonal, empty_count, m_tiles);
+	entry.opp = pattern_score(size, m, false, diagonal, empty_count, m_tiles);
+	return entry;
+}
+
+//base 3 value of a window with a 1 for every bit set in bits
+constexpr uint32_t ternary_value(uint32_t bits, unsigned int window) {
+	uint32_t value = 0;
+	for (int k = window-1; k >= 0; k--)
+		value = value*3 + ((bits >> k) & 1u);
+	return value;
+}
+
+constexpr uint32_t pow3(unsigned int exponent) {
+	return exponent == 0 ? 1 : 3 * pow3(exponent - 1);
+}
+
+/* Scores of every pattern window along a line for m, built at run time.
+ * Windows that do not start a run score 0.
+ */
+struct PatternTable {
+	unsigned int m;
+	unsigned int window;
+	uint32_t window_mask;
+	//base 3 value of the window with a 1 for every bit set in the index
+	std::vector<uint32_t> ternary;
+	//[diagonal], since the diagonal m-2 scores differ
+	std::vector<PatternEntry> entries[2];
+
+	void build(unsigned int match) {
+		m = match;
+		window = m + 3;
+		window_mask = (1u << window) - 1;
+		ternary.assign(1u << window, 0);
+		for (uint32_t bits = 0; bits <= window_mask; bits++)
+			ternary[bits] = ternary_value(bits, window);
+		uint32_t count = pow3(window);
+		for (int diagonal = 0; diagonal < 2; diagonal++) {
+			entries[diagonal].resize(count);
+			for (uint32_t index = 0; index < count; index++)
+				entries[diagonal][index] = pattern_entry(m, diagonal, index);
+		}
+	}
+
+	/* Looks up the run starting at tile k of a line
+	 * Preconditions: own and opp = the line's pieces shifted up 2 tiles,
+	 *                with the tiles off the board set in opp
+	 */
+	const PatternEntry &lookup(bool diagonal, uint64_t own, uint64_t opp, unsigned int k) const {
+		uint32_t index = ternary[(own >> k) & window_mask] + 2*ternary[(opp >> k) & window_mask];
+		return entries[diagonal][index];
+	}
+};
+
+PatternTable pattern_tables[PATTERN_TABLE_MAX_M+1];
+std::once_flag pattern_tables_built[PATTERN_TABLE_MAX_M+1];
+
+//table for m, built the first time it is asked for, NULL if m is too long
+const PatternTable *pattern_table(unsigned int m) {
+	if (m > PATTERN_TABLE_MAX_M)
+		return NULL;
+	std::call_once(pattern_tables_built[m], &PatternTable::build, &pattern_tables[m], m);
+	return &pattern_tables[m];
+}
+
+//The same table as PatternTable for an m known at compile time, built by the
+//compiler into the program for the specialized engines
+template <unsigned int M>
+struct FixedPatternTable {
+	static const unsigned int window = M + 3;
+	static const uint32_t window_mask = (1u << window) - 1;
+	uint32_t ternary[1u << window];
+	PatternEntry entries[2][pow3(window)];
+
+	constexpr FixedPatternTable(): ternary(), entries() {
+		for (uint32_t bits = 0; bits <= window_mask; bits++)
+			ternary[bits] = ternary_value(bits, window);
+		for (int diagonal = 0; diagonal < 2; diagonal++) {
+			for (uint32_t index = 0; index < pow3(window); index++)
+				entries[diagonal][index] = pattern_entry(M, diagonal, index);
+		}
+	}
+
+	const PatternEntry &lookup(bool diagonal, uint64_t own, uint64_t opp, unsigned int k) const {
+		uint32_t index = ternary[(own >> k) & window_mask] + 2*ternary[(opp >> k) & window_mask];
+		return entries[diagonal][index];
+	}
+};
+
+template <unsigned int M>
+constexpr FixedPatternTable<M> fixed_pattern_table = FixedPatternTable<M>();
+
+//Zobrist keys, one random number per player per tile, xored together for
+//every piece on the board to give a 64 bit key for the position
+uint64_t zobrist_keys[2][MAX_BOARD_LIMIT*MAX_BOARD_LIMIT];
+//xored into search keys, since scores depend on whose perspective they are
+//from and on whether the node is a max or a min node
+uint64_t zobrist_o_persp;
+uint64_t zobrist_max_node;
+
+//splitmix64, used to fill the zobrist keys with fixed random numbers
+uint64_t splitmix64(uint64_t &state) {
+	uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+void init_zobrist() {
+	uint64_t state = 20131107;
+	for (int player = 0; player < 2; player++) {
+		for (int i = 0; i < MAX_BOARD_LIMIT*MAX_BOARD_LIMIT; i++)
+			zobrist_keys[player][i] = splitmix64(state);
+	}
+	zobrist_o_persp = splitmix64(state);
+	zobrist_max_node = splitmix64(state);
+}
+
+/* xoshiro256**, the random numbers of random players, rollouts and match
+ * openings.  Each game or thread keeps its own generator, so they draw from
+ * their own seeds without sharing rand()'s state
+ */
+struct Xoshiro {
+	uint64_t s[4];
+
+	Xoshiro(uint64_t seed_value=0) {
+		seed(seed_value);
+	}
+
+	//the state is filled from splitmix64, which never gives all zeros
+	void seed(uint64_t seed_value) {
+		for (int i = 0; i < 4; i++)
+			s[i] = splitmix64(seed_value);
+	}
+
+	static uint64_t rotl(uint64_t x, int k) {
+		return (x << k) | (x >> (64 - k));
+	}
+
+	uint64_t next() {
+		uint64_t result = rotl(s[1] * 5, 7) * 9;
+		uint64_t t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+		return result;
+	}
+
+	//uniform in 0 to bound-1, from the high bits scaled instead of a modulo
+	uint32_t below(uint32_t bound) {
+		return ((next() >> 32) * bound) >> 32;
+	}
+};
+
+/* Every empty tile of a board, as row*MAX_BOARD_LIMIT+column, packed at the
+ * front of tiles[], and where each one is in it.  A tile is taken out by
+ * moving the last one into its place, so taking tiles out, putting them back
+ * and picking a random empty tile all take the same time however full the
+ * board is
+ */
+struct EmptyCells {
+	unsigned short tiles[MAX_BOARD_LIMIT*MAX_BOARD_LIMIT];
+	unsigned short place[MAX_BOARD_LIMIT*MAX_BOARD_LIMIT];
+	unsigned int count;
+
+	//every tile of an n x n board
+	void reset(unsigned int n) {
+		count = 0;
+		for (unsigned int row = 0; row < n; row++) {
+			for (unsigned int column = 0; column < n; column++)
+				add(row*MAX_BOARD_LIMIT + column);
+		}
+	}
+
+	void add(unsigned int tile) {
+		place[tile] = count;
+		tiles[count++] = tile;
+	}
+
+	void remove(unsigned int tile) {
+		unsigned int last = tiles[--count];
+		tiles[place[tile]] = last;
+		place[last] = place[tile];
+	}
+
+	//a uniformly random empty tile, count has to be above 0
+	unsigned int sample(Xoshiro &random) const {
+		return tiles[random.below(count)];
+	}
+};
+
+/* (row, column) on an n x n board under symmetry s of the 8 of a square:
+ * bit 2 transposes, then bit 0 flips the rows and bit 1 the columns
+ */
+std::pair<int, int> symmetry_tile(unsigned int s, unsigned int n, int row, int column) {
+	if (s & 4)
+		std::swap(row, column);
+	if (s & 1)
+		row = n - 1 - row;
+	if (s & 2)
+		column = n - 1 - column;
+	return std::pair<int, int>(row, column);
+}
+
+//the tile symmetry_tile maps to (row, column)
+std::pair<int, int> inverse_symmetry_tile(unsigned int s, unsigned int n, int row, int column) {
+	if (s & 1)
+		row = n - 1 - row;
+	if (s & 2)
+		column = n - 1 - column;
+	if (s & 4)
+		std::swap(row, column);
+	return std::pair<int, int>(row, column);
+}
+
+//Fields of a GameState that make_move changes and unmake_move puts back
+struct MoveUndo {
+	bool game_end;
+	int hscore;
+	unsigned int last_row;
+	unsigned int last_column;
+	uint32_t column_mask;
+};
+
 //Struct used to keep track of game state and information regarding state
+//The board is kept as two bit planes, one per player, so the struct is a
+//fixed size block of memory that can be copied without any allocations
 struct GameState {
 	bool game_end;
 	int hscore;
@@ -66,57 +482,485 @@ struct GameState {
 	unsigned int tiles_left;
 	unsigned int last_row;
 	unsigned int last_column;
-	std::vector<bool> column_count;
-	std::vector<char> board;
+	//bit i is set when column i has at least one piece in it
+	uint32_t column_mask;
+	//x_rows[row] bit column is set when X has a piece on the tile
+	uint32_t x_rows[MAX_BOARD_LIMIT];
+	uint32_t o_rows[MAX_BOARD_LIMIT];
+	//# of pieces in a row to match
+	unsigned int m;
+	//score of every line from X's and O's perspective, and # of exactly m
+	//patterns on it, kept up to date by set() for the 4 lines through a move
+	int line_x[4][MAX_LINES];
+	int line_o[4][MAX_LINES];
+	unsigned char line_x_wins[4][MAX_LINES];
+	unsigned char line_o_wins[4][MAX_LINES];
+	//sums of the line values above
+	int total_x;
+	int total_o;
+	int wins_x;
+	int wins_o;
+	//zobrist key of the pieces on the board
+	uint64_t key;
+	//zobrist keys of the board turned by each symmetry of symmetry_tile,
+	//sym_keys[0] being key
+	uint64_t sym_keys[8];
+	//pattern scores for m, NULL when m is too long for a table
+	const PatternTable *patterns;
+	//the empty tiles, kept up to date by set() and unset()
+	EmptyCells empty;
 
-	GameState(unsigned int size=0): game_end(false), n(size),
-		tiles_left(size*size), last_row(0), last_column(0)
-		{column_count.assign(size, false); board.assign(size*size, '.');};
+	GameState(unsigned int size=0, unsigned int match=3): game_end(false),
+		hscore(0), n(size), tiles_left(size*size), last_row(0), last_column(0),
+		column_mask(0), m(match), total_x(0), total_o(0), wins_x(0), wins_o(0),
+		key(0), patterns(pattern_table(match)) {
+		for (int i = 0; i < MAX_BOARD_LIMIT; i++) {
+			x_rows[i] = 0;
+			o_rows[i] = 0;
+		}
+		for (int s = 0; s < 8; s++)
+			sym_keys[s] = 0;
+		for (int dir = 0; dir < 4; dir++) {
+			for (int i = 0; i < MAX_LINES; i++) {
+				line_x[dir][i] = 0;
+				line_o[dir][i] = 0;
+				line_x_wins[dir][i] = 0;
+				line_o_wins[dir][i] = 0;
+			}
+		}
+		empty.reset(size);
+	};
 
-	char at(unsigned int row, unsigned int column) {
-		unsigned pos = (row*n)+column;
-		return board[pos];
+	char at(unsigned int row, unsigned int column) const {
+		uint32_t bit = 1u << column;
+		if (x_rows[row] & bit)
+			return 'X';
+		if (o_rows[row] & bit)
+			return 'O';
+		return '.';
 	}
 
+	/* The methods templated on <N, M> are the ones the search calls for every
+	 * node.  N and M are the board size and m when they are known at compile
+	 * time, so the specialized engines get fixed loop bounds and masks, and 0
+	 * when they are read from n and m.
+	 */
+	template <unsigned int N=0, unsigned int M=0>
 	void set(unsigned int row, unsigned int column, char player) {
-		unsigned pos = (row*n)+column;
-		board[pos] = player;
-		column_count[column] = true;
+		uint32_t bit = 1u << column;
+		unsigned int tile = row*MAX_BOARD_LIMIT + column;
+		if (player == 'X') {
+			x_rows[row] |= bit;
+			key ^= zobrist_keys[0][tile];
+		}
+		else {
+			o_rows[row] |= bit;
+			key ^= zobrist_keys[1][tile];
+		}
+		column_mask |= bit;
 		last_column = column;
 		last_row = row;
 		tiles_left--;
+		empty.remove(tile);
+		toggle_symmetry_keys<N>(row, column, player);
+		rescore_line<N, M>(DIR_DOWN, column);
+		rescore_line<N, M>(DIR_RIGHT, row);
+		rescore_line<N, M>(DIR_TOPR, row + column);
+		rescore_line<N, M>(DIR_BOTR, row + ((N ? N : n)-1) - column);
+	}
+
+	//adds or takes player's piece on (row, column) out of the 8 symmetry keys
+	template <unsigned int N=0>
+	void toggle_symmetry_keys(unsigned int row, unsigned int column, char player) {
+		const unsigned int n = N ? N : this->n;
+		const uint64_t *keys = zobrist_keys[(player == 'X') ? 0 : 1];
+		//the tiles of symmetry_tile, written out: (row, column) flipped
+		//by rows and by columns, then the same transposed
+		unsigned int flip_row = n - 1 - row;
+		unsigned int flip_column = n - 1 - column;
+		sym_keys[0] ^= keys[row*MAX_BOARD_LIMIT + column];
+		sym_keys[1] ^= keys[flip_row*MAX_BOARD_LIMIT + column];
+		sym_keys[2] ^= keys[row*MAX_BOARD_LIMIT + flip_column];
+		sym_keys[3] ^= keys[flip_row*MAX_BOARD_LIMIT + flip_column];
+		sym_keys[4] ^= keys[column*MAX_BOARD_LIMIT + row];
+		sym_keys[5] ^= keys[flip_column*MAX_BOARD_LIMIT + row];
+		sym_keys[6] ^= keys[column*MAX_BOARD_LIMIT + flip_row];
+		sym_keys[7] ^= keys[flip_column*MAX_BOARD_LIMIT + flip_row];
+	}
+
+	/* Key of the board that is the same for all 8 turns and flips of it, the
+	 * least of their keys
+	 * Postconditions: symmetry = the symmetry whose key it is; a move on
+	 *                 this board is symmetry_tile(symmetry, ...) on the
+	 *                 board with that key
+	 */
+	uint64_t canonical_key(unsigned int &symmetry) const {
+		symmetry = 0;
+		for (unsigned int s = 1; s < 8; s++) {
+			if (sym_keys[s] < sym_keys[symmetry])
+				symmetry = s;
+		}
+		return sym_keys[symmetry];
+	}
+
+	//true if player's piece on the empty tile (row, column) would make exactly
+	//m in a row, walks out from the tile in the 4 directions
+	template <unsigned int N=0, unsigned int M=0>
+	bool wins_at(unsigned int row, unsigned int column, char player) const {
+		static const int steps[4][2] = {{1, 0}, {0, 1}, {-1, 1}, {1, 1}};
+		const unsigned int n = N ? N : this->n;
+		const unsigned int m = M ? M : this->m;
+		const uint32_t *own = (player == 'X') ? x_rows : o_rows;
+		for (int dir = 0; dir < 4; dir++) {
+			unsigned int size = 1;
+			for (int side = -1; side <= 1; side += 2) {
+				int r = row + side*steps[dir][0];
+				int c = column + side*steps[dir][1];
+				while (size <= m && r >= 0 && r < (int)n && c >= 0 && c < (int)n
+					&& ((own[r] >> c) & 1u)) {
+					size++;
+					r += side*steps[dir][0];
+					c += side*steps[dir][1];
+				}
+			}
+			if (size == m)
+				return true;
+		}
+		return false;
+	}
+
+	//takes a piece back off the board, the reverse of set()
+	template <unsigned int N=0, unsigned int M=0>
+	void unset(unsigned int row, unsigned int column) {
+		uint32_t bit = 1u << column;
+		unsigned int tile = row*MAX_BOARD_LIMIT + column;
+		if (x_rows[row] & bit)
+			key ^= zobrist_keys[0][tile];
+		else if (o_rows[row] & bit)
+			key ^= zobrist_keys[1][tile];
+		if ((x_rows[row] | o_rows[row]) & bit) {
+			empty.add(tile);
+			toggle_symmetry_keys<N>(row, column, (x_rows[row] & bit) ? 'X' : 'O');
+		}
+		x_rows[row] &= ~bit;
+		o_rows[row] &= ~bit;
+		tiles_left++;
+		//the column is only marked while some row still has a piece in it
+		uint32_t pieces = 0;
+		for (unsigned int r = 0; r < (N ? N : n); r++)
+			pieces |= x_rows[r] | o_rows[r];
+		column_mask &= pieces | ~bit;
+		rescore_line<N, M>(DIR_DOWN, column);
+		rescore_line<N, M>(DIR_RIGHT, row);
+		rescore_line<N, M>(DIR_TOPR, row + column);
+		rescore_line<N, M>(DIR_BOTR, row + ((N ? N : n)-1) - column);
+	}
+
+	/* Places player's piece and scores the board from score_player's
+	 * perspective, used by the search instead of copying the state
+	 * Postconditions: Returns what unmake_move needs to undo the move
+	 */
+	template <unsigned int N=0, unsigned int M=0>
+	MoveUndo make_move(unsigned int row, unsigned int column, char player, char score_player) {
+		MoveUndo undo;
+		undo.game_end = game_end;
+		undo.hscore = hscore;
+		undo.last_row = last_row;
+		undo.last_column = last_column;
+		undo.column_mask = column_mask;
+		set<N, M>(row, column, player);
+		evaluate(score_player);
+		return undo;
+	}
+
+	template <unsigned int N=0, unsigned int M=0>
+	void unmake_move(unsigned int row, unsigned int column, const MoveUndo &undo) {
+		unset<N, M>(row, column);
+		game_end = undo.game_end;
+		hscore = undo.hscore;
+		last_row = undo.last_row;
+		last_column = undo.last_column;
+		column_mask = undo.column_mask;
+	}
+
+	//first tile of line idx in direction dir, and the step to the next tile
+	template <unsigned int N=0>
+	void line_start(int dir, unsigned int idx, int &row, int &column,
+		int &row_step, int &column_step) const {
+		const unsigned int n = N ? N : this->n;
+		if (dir == DIR_DOWN) {
+			row = 0; column = idx; row_step = 1; column_step = 0;
+		}
+		else if (dir == DIR_RIGHT) {
+			row = idx; column = 0; row_step = 0; column_step = 1;
+		}
+		else if (dir == DIR_TOPR) {
+			//starts at the bottom left end of the line
+			row = (idx < n) ? idx : n-1;
+			column = idx - row; row_step = -1; column_step = 1;
+		}
+		else {
+			//starts at the top left end of the line
+			row = (idx >= n-1) ? idx - (n-1) : 0;
+			column = row + (n-1) - idx; row_step = 1; column_step = 1;
+		}
+	}
+
+	/* Copies line idx in direction dir into bit masks, bit k being the k-th
+	 * tile along the line
+	 * Postconditions: Returns the # of tiles on the line
+	 */
+	template <unsigned int N=0>
+	unsigned int line_bits(int dir, unsigned int idx, uint32_t &x_line, uint32_t &o_line) const {
+		const unsigned int n = N ? N : this->n;
+		if (dir == DIR_RIGHT) {
+			x_line = x_rows[idx];
+			o_line = o_rows[idx];
+			return n;
+		}
+		int row, column, row_step, column_step;
+		line_start<N>(dir, idx, row, column, row_step, column_step);
+		unsigned int len = 0;
+		x_line = 0;
+		o_line = 0;
+		while (row >= 0 && row < (int)n && column < (int)n) {
+			x_line |= ((x_rows[row] >> column) & 1u) << len;
+			o_line |= ((o_rows[row] >> column) & 1u) << len;
+			len++;
+			row += row_step;
+			column += column_step;
+		}
+		return len;
+	}
+
+	//entry of the run at tile k, from the compiled in table when M is known
+	template <unsigned int M>
+	const PatternEntry &lookup_pattern(bool diagonal, uint64_t own, uint64_t opp, unsigned int k) const {
+		if constexpr (M != 0)
+			return fixed_pattern_table<M>.lookup(diagonal, own, opp, k);
+		else
+			return patterns->lookup(diagonal, own, opp, k);
+	}
+
+	/* Scores a line from the pattern table, one lookup per run
+	 * Postconditions: score_x, score_o, x_wins and o_wins are the line's
+	 */
+	template <unsigned int M=0>
+	void table_scan(uint32_t x_line, uint32_t o_line, unsigned int len, bool diagonal,
+		int &score_x, int &score_o, int &x_wins, int &o_wins) const {
+		uint64_t off_board = ~((((uint64_t)1 << len) - 1) << 2);
+		uint64_t x_pad = (uint64_t)x_line << 2;
+		uint64_t o_pad = (uint64_t)o_line << 2;
+		//bits where a run of the player's pieces starts
+		uint32_t starts = x_line & ~(x_line << 1);
+		while (starts) {
+			unsigned int k = __builtin_ctz(starts);
+			starts &= starts - 1;
+			const PatternEntry &entry = lookup_pattern<M>(diagonal, x_pad, o_pad | off_board, k);
+			score_x += entry.own;
+			score_o += entry.opp;
+			x_wins += entry.win;
+		}
+		starts = o_line & ~(o_line << 1);
+		while (starts) {
+			unsigned int k = __builtin_ctz(starts);
+			starts &= starts - 1;
+			const PatternEntry &entry = lookup_pattern<M>(diagonal, o_pad, x_pad | off_board, k);
+			score_o += entry.own;
+			score_x += entry.opp;
+			o_wins += entry.win;
+		}
+	}
+
+	/* Scores a line by walking its runs, for m too long for a pattern table
+	 * Postconditions: score_x, score_o, x_wins and o_wins are the line's
+	 */
+	void run_scan(uint32_t x_line, uint32_t o_line, unsigned int len, bool diagonal,
+		int &score_x, int &score_o, int &x_wins, int &o_wins) const {
+		uint32_t empty_line = ~(x_line | o_line) & ((1u << len) - 1);
+		unsigned int k = 0;
+		while (k < len) {
+			uint32_t pieces = x_line | o_line;
+			if (!((pieces >> k) & 1u)) {
+				k++;
+				continue;
+			}
+			bool x_piece = (x_line >> k) & 1u;
+			uint32_t own_line = x_piece ? x_line : o_line;
+			unsigned int size = __builtin_ctz(~(own_line >> k));
+			if (size == m) {
+				if (x_piece)
+					x_wins++;
+				else
+					o_wins++;
+			}
+			else {
+				int empty_count = 0;
+				bool m_tiles = false;
+				if (k >= 1 && ((empty_line >> (k-1)) & 1u))
+					empty_count++;
+				if (k+size < len && ((empty_line >> (k+size)) & 1u))
+					empty_count++;
+				if (k >= 2 && ((empty_line >> (k-2)) & 1u))
+					m_tiles = true;
+				if (k+size+1 < len && ((empty_line >> (k+size+1)) & 1u))
+					m_tiles = true;
+				score_x += pattern_score(size, m, x_piece, diagonal, empty_count, m_tiles);
+				score_o += pattern_score(size, m, !x_piece, diagonal, empty_count, m_tiles);
+			}
+			k += size;
+		}
+	}
+
+	//recomputes the score of a single line and updates the totals with it
+	template <unsigned int N=0, unsigned int M=0>
+	void rescore_line(int dir, unsigned int idx) {
+		static_assert(M <= PATTERN_TABLE_MAX_M, "specialized m has to have a pattern table");
+		uint32_t x_line, o_line;
+		unsigned int len = line_bits<N>(dir, idx, x_line, o_line);
+		bool diagonal = (dir == DIR_TOPR || dir == DIR_BOTR);
+		int score_x = 0, score_o = 0;
+		int x_wins = 0, o_wins = 0;
+		if (M != 0 || patterns)
+			table_scan<M>(x_line, o_line, len, diagonal, score_x, score_o, x_wins, o_wins);
+		else
+			run_scan(x_line, o_line, len, diagonal, score_x, score_o, x_wins, o_wins);
+		total_x += score_x - line_x[dir][idx];
+		total_o += score_o - line_o[dir][idx];
+		wins_x += x_wins - line_x_wins[dir][idx];
+		wins_o += o_wins - line_o_wins[dir][idx];
+		line_x[dir][idx] = score_x;
+		line_o[dir][idx] = score_o;
+		line_x_wins[dir][idx] = x_wins;
+		line_o_wins[dir][idx] = o_wins;
+	}
+
+	/* Sets hscore and game_end from the line totals, from the perspective of
+	 * player.  Gives the same result as a full heuristics_full_scan, so
+	 * game_end is cleared again once the winning move is unset.
+	 */
+	void evaluate(char player) {
+		game_end = false;
+		int own_wins = (player == 'X') ? wins_x : wins_o;
+		int opp_wins = (player == 'X') ? wins_o : wins_x;
+		if (own_wins > 0) {
+			hscore = SCORE_WIN;
+			game_end = true;
+		}
+		else if (opp_wins > 0) {
+			hscore = SCORE_LOSE;
+			game_end = true;
+		}
+		else {
+			hscore = (player == 'X') ? total_x : total_o;
+			//if there are no more tiles yet no winnning pattern detected,
+			//then game ends in a draw
+			if (tiles_left == 0)
+				game_end = true;
+		}
+	}
+
+	//mask of the tiles in a row that are on the board
+	template <unsigned int N=0>
+	uint32_t row_mask() const {
+		const unsigned int n = N ? N : this->n;
+		return (n >= ROW_BITS) ? 0xFFFFFFFFu : ((1u << n) - 1);
+	}
+
+	//fills out[] with the empty tiles within radius rows and columns of any
+	//piece, radius 1 being the 8 tiles next to it
+	template <unsigned int N=0>
+	void neighbors(uint32_t *out, unsigned int radius=1) const {
+		const unsigned int n = N ? N : this->n;
+		uint32_t occ[MAX_BOARD_LIMIT] = {};
+		for (unsigned int r = 0; r < n; r++)
+			occ[r] = x_rows[r] | o_rows[r];
+		dilate_plane<N>(occ, out, n, radius);
+		for (unsigned int r = 0; r < n; r++)
+			out[r] &= ~occ[r];
 	}
 };
 
-void print_board(GameState cur_state) {
+//zobrist key of board turned by symmetry s, from scratch, what
+//GameState::sym_keys[s] keeps up to date
+uint64_t symmetry_key(const GameState &board, unsigned int s) {
+	uint64_t key = 0;
+	for (unsigned int row = 0; row < board.n; row++) {
+		for (int player = 0; player < 2; player++) {
+			uint32_t bits = player ? board.o_rows[row] : board.x_rows[row];
+			while (bits) {
+				std::pair<int, int> tile = symmetry_tile(s, board.n, row, __builtin_ctz(bits));
+				bits &= bits - 1;
+				key ^= zobrist_keys[player][tile.first*MAX_BOARD_LIMIT + tile.second];
+			}
+		}
+	}
+	return key;
+}
+
+void print_board(const GameState &cur_state) {
 	unsigned int size = cur_state.n;
-	unsigned int total_size = size * size;
 	std::cout << " GOMOKU GAMEBOARD: " << std::endl;
-	for (int i = 0; i < (total_size); i++) {
-		if (i == 0)
-			std::cout << "  ";
-		if (i%size == 0 && i != 0)
-			std::cout << std::endl << "  ";
-		std::cout << cur_state.board[i];
+	for (unsigned int row = 0; row < size; row++) {
+		std::cout << "  ";
+		for (unsigned int column = 0; column < size; column++)
+			std::cout << cur_state.at(row, column);
+		std::cout << std::endl;
 	}
-	std::cout << std::endl;
 }
 
-GameState heuristics_func(GameState node, const int m, const char cur_player) {
-	int board_size = node.column_count.size();
+/* Builds the planes of tiles that start a line pattern for each of the four
+ * directions heuristics_func walks in.  A tile starts a pattern when the tile
+ * before it in that direction does not hold the same piece, which replaces
+ * keeping sets of already checked coordinates.
+ */
+void pattern_starts(const GameState &node, uint32_t *down, uint32_t *right,
+	uint32_t *topR, uint32_t *botR) {
+	uint32_t x_prev[MAX_BOARD_LIMIT], o_prev[MAX_BOARD_LIMIT];
+	unsigned int n = node.n;
+	//top to bottom, the tile before is the one above
+	shift_plane(node.x_rows, x_prev, n, 1, 0);
+	shift_plane(node.o_rows, o_prev, n, 1, 0);
+	for (unsigned int r = 0; r < n; r++)
+		down[r] = (node.x_rows[r] & ~x_prev[r]) | (node.o_rows[r] & ~o_prev[r]);
+	//left to right, the tile before is the one on the left
+	shift_plane(node.x_rows, x_prev, n, 0, 1);
+	shift_plane(node.o_rows, o_prev, n, 0, 1);
+	for (unsigned int r = 0; r < n; r++)
+		right[r] = (node.x_rows[r] & ~x_prev[r]) | (node.o_rows[r] & ~o_prev[r]);
+	//bottom left to top right, the tile before is the bottom left one
+	shift_plane(node.x_rows, x_prev, n, -1, 1);
+	shift_plane(node.o_rows, o_prev, n, -1, 1);
+	for (unsigned int r = 0; r < n; r++)
+		topR[r] = (node.x_rows[r] & ~x_prev[r]) | (node.o_rows[r] & ~o_prev[r]);
+	//top left to bottom right, the tile before is the top left one
+	shift_plane(node.x_rows, x_prev, n, 1, 1);
+	shift_plane(node.o_rows, o_prev, n, 1, 1);
+	for (unsigned int r = 0; r < n; r++)
+		botR[r] = (node.x_rows[r] & ~x_prev[r]) | (node.o_rows[r] & ~o_prev[r]);
+}
+
+/* Scores the whole board by walking every line pattern on it.  This is the
+ * reference heuristics_func is checked against when built with DEBUG_EVAL.
+ * Preconditions: node = game board, m = # of tiles in a row to match,
+ *                cur_player = player's perspective for the score
+ * Postconditions: Returns node with hscore and game_end set
+ */
+GameState heuristics_full_scan(GameState node, const int m, const char cur_player) {
+	int board_size = node.n;
 	node.hscore = 0;
-	//checked_coords_columns used to handle right to left pattern checking
-	//checked cords diags used to handle both diagonl directions
-	std::set< std::pair<int, int> > checked_coords_columns;
-	std::set< std::pair<int, int> > checked_coords_diag_botR;
-	std::set< std::pair<int, int> > checked_coords_diag_topR;
+	//start planes mark the first tile of each line pattern, so each pattern
+	//is only checked once per direction
+	uint32_t start_down[MAX_BOARD_LIMIT];
+	uint32_t start_right[MAX_BOARD_LIMIT];
+	uint32_t start_topR[MAX_BOARD_LIMIT];
+	uint32_t start_botR[MAX_BOARD_LIMIT];
+	pattern_starts(node, start_down, start_right, start_topR, start_botR);
 
 	//checks for matching game patterns, column first with i as column
 	for (int i = 0 ; i < board_size; i++) {
 		//if there is a piece on a column, check the column for a pattern
-		if (node.column_count[i]) {
-			//checked_coords used to handle top to bottom pattern checking
-			std::set< std::pair<int, int> > checked_coords;
+		if (node.column_mask & (1u << i)) {
 			//checks row by each in each column, with j as row
 			//starts by checking each piece from top to bottom of a column
 			for (int j = 0;  j < board_size; j++) {
@@ -127,15 +971,14 @@ GameState heuristics_func(GameState node, const int m, const char cur_player) {
 					std::pair<int, int> cur_pos;
 					cur_pos.first = cur_row;
 					cur_pos.second = i;
-					//checks if this position has already been looked at by the function
-					if (checked_coords.find(cur_pos) == checked_coords.end()) {
+					//checks if this position starts a pattern in this direction
+					if (start_down[cur_pos.first] & (1u << cur_pos.second)) {
 						//if this piece is the player's
 						if (cur_piece == cur_player) {
 							unsigned int cur_pattern_size = 1;
 							//start_pattern and end_pattern tracks current row
 							int start_pattern = cur_pos.first;
 							int end_pattern = cur_pos.first;
-							checked_coords.insert(cur_pos);
 							if (cur_row+1 < board_size) {
 								cur_row++;
 								cur_piece = node.at(cur_row, i);
@@ -145,7 +988,6 @@ GameState heuristics_func(GameState node, const int m, const char cur_player) {
 									cur_pos.first = cur_row;
 									cur_pos.second = i;
 									end_pattern = cur_pos.first;
-									checked_coords.insert(cur_pos);
 									cur_pattern_size++;
 									if (cur_row+1 < board_size) {
 										cur_row++;
@@ -248,7 +1090,6 @@ GameState heuristics_func(GameState node, const int m, const char cur_player) {
 							unsigned int cur_pattern_size = 1;
 							int start_pattern = cur_pos.first;
 							int end_pattern = cur_pos.first;
-							checked_coords.insert(cur_pos);
 							if (cur_row+1 < board_size) {
 								cur_row++;
 								cur_piece = node.at(cur_row, i);
@@ -258,7 +1099,6 @@ GameState heuristics_func(GameState node, const int m, const char cur_player) {
 									cur_pos.first = cur_row;
 									cur_pos.second = i;
 									end_pattern = cur_pos.first;
-									checked_coords.insert(cur_pos);
 									cur_pattern_size++;
 									if (cur_row+1 < board_size) {
 										cur_row++;
@@ -368,15 +1208,14 @@ GameState heuristics_func(GameState node, const int m, const char cur_player) {
 					std::pair<int, int> cur_pos;
 					cur_pos.first = cur_row;
 					cur_pos.second = cur_column;
-					//checks if this position has already been looked at by the function
-					if (checked_coords_columns.find(cur_pos) == checked_coords_columns.end()) {
+					//checks if this position starts a pattern in this direction
+					if (start_right[cur_pos.first] & (1u << cur_pos.second)) {
 						//if this piece is the player's
 						if (cur_piece == cur_player) {
 							unsigned int cur_pattern_size = 1;
 							//start_pattern and end_pattern tracks columns
 							int start_pattern = cur_pos.second;
 							int end_pattern = cur_pos.second;
-							checked_coords_columns.insert(cur_pos);
 							if (cur_column+1 < board_size) {
 								cur_column++;
 								cur_piece = node.at(cur_row, cur_column);
@@ -386,7 +1225,6 @@ GameState heuristics_func(GameState node, const int m, const char cur_player) {
 									cur_pos.first = cur_row;
 									cur_pos.second = cur_column;
 									end_pattern = cur_pos.second;
-									checked_coords_columns.insert(cur_pos);
 									cur_pattern_size++;
 									if (cur_column+1 < board_size) {
 										cur_column++;
@@ -489,7 +1327,6 @@ GameState heuristics_func(GameState node, const int m, const char cur_player) {
 							unsigned int cur_pattern_size = 1;
 							int start_pattern = cur_pos.second;
 							int end_pattern = cur_pos.second;
-							checked_coords_columns.insert(cur_pos);
 							if (cur_column+1 < board_size) {
 								cur_column++;
 								cur_piece = node.at(cur_row, cur_column);
@@ -499,7 +1336,6 @@ GameState heuristics_func(GameState node, const int m, const char cur_player) {
 									cur_pos.first = cur_row;
 									cur_pos.second = cur_column;
 									end_pattern = cur_pos.second;
-									checked_coords_columns.insert(cur_pos);
 									cur_pattern_size++;
 									if (cur_column+1 < board_size) {
 										cur_column++;
@@ -609,15 +1445,14 @@ GameState heuristics_func(GameState node, const int m, const char cur_player) {
 					std::pair<int, int> cur_pos;
 					cur_pos.first = cur_row;
 					cur_pos.second = cur_column;
-					//checks if this position has already been looked at by the function
-					if (checked_coords_diag_topR.find(cur_pos) == checked_coords_diag_topR.end()) {
+					//checks if this position starts a pattern in this direction
+					if (start_topR[cur_pos.first] & (1u << cur_pos.second)) {
 						//if this piece is the player's
 						if (cur_piece == cur_player) {
 							unsigned int cur_pattern_size = 1;
 							//start_pattern and end_pattern tracks columns
 							std::pair<int, int> start_pattern = cur_pos;
 							std::pair<int, int> end_pattern = cur_pos;
-							checked_coords_diag_topR.insert(cur_pos);
 							if ((cur_column+1 < board_size) && (cur_row-1 >= 0)) {
 								cur_column++;
 								cur_row--;
@@ -628,7 +1463,6 @@ GameState heuristics_func(GameState node, const int m, const char cur_player) {
 									cur_pos.first = cur_row;
 									cur_pos.second = cur_column;
 									end_pattern = cur_pos;
-									checked_coords_diag_topR.insert(cur_pos);
 									cur_pattern_size++;
 									if ((cur_column+1 < board_size) && (cur_row-1 >= 0)) {
 										cur_column++;
@@ -732,7 +1566,6 @@ GameState heuristics_func(GameState node, const int m, const char cur_player) {
 							unsigned int cur_pattern_size = 1;
 							std::pair<int, int> start_pattern = cur_pos;
 							std::pair<int, int> end_pattern = cur_pos;
-							checked_coords_diag_topR.insert(cur_pos);
 							if ((cur_column+1 < board_size) && (cur_row-1 >= 0)) {
 								cur_column++;
 								cur_row--;
@@ -743,7 +1576,6 @@ GameState heuristics_func(GameState node, const int m, const char cur_player) {
 									cur_pos.first = cur_row;
 									cur_pos.second = cur_column;
 									end_pattern = cur_pos;
-									checked_coords_diag_topR.insert(cur_pos);
 									cur_pattern_size++;
 									if ((cur_column+1 < board_size) && (cur_row-1 >= 0)) {
 										cur_column++;
@@ -851,15 +1683,14 @@ GameState heuristics_func(GameState node, const int m, const char cur_player) {
 					std::pair<int, int> cur_pos;
 					cur_pos.first = cur_row;
 					cur_pos.second = cur_column;
-					//checks if this position has already been looked at by the function
-					if (checked_coords_diag_botR.find(cur_pos) == checked_coords_diag_botR.end()) {
+					//checks if this position starts a pattern in this direction
+					if (start_botR[cur_pos.first] & (1u << cur_pos.second)) {
 						//if this piece is the player's
 						if (cur_piece == cur_player) {
 							unsigned int cur_pattern_size = 1;
 							//start_pattern and end_pattern tracks columns
 							std::pair<int, int> start_pattern = cur_pos;
 							std::pair<int, int> end_pattern = cur_pos;
-							checked_coords_diag_botR.insert(cur_pos);
 							if ((cur_column+1 < board_size) && (cur_row+1 < board_size)) {
 								cur_column++;
 								cur_row++;
@@ -870,7 +1701,6 @@ GameState heuristics_func(GameState node, const int m, const char cur_player) {
 									cur_pos.first = cur_row;
 									cur_pos.second = cur_column;
 									end_pattern = cur_pos;
-									checked_coords_diag_botR.insert(cur_pos);
 									cur_pattern_size++;
 									if ((cur_column+1 < board_size) && (cur_row+1 < board_size)) {
 										cur_column++;
@@ -974,7 +1804,6 @@ GameState heuristics_func(GameState node, const int m, const char cur_player) {
 							unsigned int cur_pattern_size = 1;
 							std::pair<int, int> start_pattern = cur_pos;
 							std::pair<int, int> end_pattern = cur_pos;
-							checked_coords_diag_botR.insert(cur_pos);
 							if ((cur_column+1 < board_size) && (cur_row+1 < board_size)) {
 								cur_column++;
 								cur_row++;
@@ -985,7 +1814,6 @@ GameState heuristics_func(GameState node, const int m, const char cur_player) {
 									cur_pos.first = cur_row;
 									cur_pos.second = cur_column;
 									end_pattern = cur_pos;
-									checked_coords_diag_botR.insert(cur_pos);
 									cur_pattern_size++;
 									if ((cur_column+1 < board_size) && (cur_row+1 < board_size)) {
 										cur_column++;
@@ -1096,343 +1924,3128 @@ GameState heuristics_func(GameState node, const int m, const char cur_player) {
 	return node;
 }
 
-/* Generates all game boards with pieces added next to each existing piece on the
- * board. The 8 tiles around each tile on the board is generated if possible
- * Preconditions: cur_board = node, m =  # of tiles in a row to match,
- *                score_player = player's perspective when using heuristics,
- *                player = current player to generate new moves with
- * Postconditions: Returns a deque of GameStates representing all valid generated
- *                 nodes
- */
-std::deque<GameState> gen_all_moves(GameState cur_board, const unsigned int m, const char score_player, const char player) {
-	std::deque<GameState> move_list;
-	std::set< std::pair<int, int> > gen_coords_list;
-	bool empty_board = true;
-	int board_column_size = cur_board.column_count.size();
-	//loops through the board and add to a list of new states to generate
-	//i = column, j = column
-	for (int i = 0; i < board_column_size; i++) {
-		//check if there are any pieces in the column
-		if (cur_board.column_count[i]) {
-			empty_board = false;
-			for (int j = 0; j < board_column_size; j++) {
-				if (cur_board.at(j, i) != '.') {
-					//add top tile to gen list
-					if (j-1 >= 0) {
-						if (cur_board.at(j-1, i) == '.') {
-							std::pair<int, int> temp(j-1, i);
-							gen_coords_list.insert(temp);
-						}
-					}
-					//add bottom tile to gen list
-					if (j+1 < board_column_size) {
-						if (cur_board.at(j+1, i) == '.') {
-							std::pair<int, int> temp(j+1, i);
-							gen_coords_list.insert(temp);
-						}
-					}
-					//add right tile to gen list
-					if (i+1 < board_column_size) {
-						if (cur_board.at(j, i+1) == '.') {
-							std::pair<int, int> temp(j, i+1);
-							gen_coords_list.insert(temp);
-						}
-					}
-					//add left tile to gen list
-					if (i-1 >= 0) {
-						if (cur_board.at(j, i-1) == '.') {
-							std::pair<int, int> temp(j, i-1);
-							gen_coords_list.insert(temp);
-						}
-					}
-					//add top left tile
-					if ((j-1 >= 0) && (i-1 >= 0)) {
-						if (cur_board.at(j-1, i-1) == '.') {
-							std::pair<int, int> temp(j-1, i-1);
-							gen_coords_list.insert(temp);
-						}
-					}
-					//add top right tile
-					if ((j-1 >= 0) && (i+1 < board_column_size)) {
-						if (cur_board.at(j-1, i+1) == '.') {
-							std::pair<int, int> temp(j-1, i+1);
-							gen_coords_list.insert(temp);
-						}
-					}
-					//add bottom left tile
-					if ((j+1 < board_column_size) && (i-1 >= 0)) {
-						if (cur_board.at(j+1, i-1) == '.') {
-							std::pair<int, int> temp(j+1, i-1);
-							gen_coords_list.insert(temp);
-						}
-					}
-					//add bottom right tile
-					if ((j+1 < board_column_size) && (i+1 < board_column_size)) {
-						if (cur_board.at(j+1, i+1) == '.') {
-							std::pair<int, int> temp(j+1, i+1);
-							gen_coords_list.insert(temp);
-						}
-					}
-				}
-			}
-		}
-	}
-	//if the board is empty, pick the middle tile to generate new state
-	if (empty_board) {
-		int middle_board = board_column_size/2;
-		std::pair<int, int> temp(middle_board, middle_board);
-		gen_coords_list.insert(temp);
-	}
-	//for each tile coordinates, generate and append to the deque a new state
-	for (std::set< std::pair<int, int> >::iterator it = gen_coords_list.begin(); it != gen_coords_list.end(); it++) {
-		GameState temp_board = cur_board;
-		temp_board.set(it->first, it->second, player);
-		temp_board = heuristics_func(temp_board, m, score_player);
-		move_list.push_back(temp_board);
-	}
-	return move_list;
-}
+//Rows of a bit plane in the board kernel, the board rounded up so a plane
+//fills whole vectors
+#define KERNEL_ROWS 24
+//Empty rows kept above and below the planes the kernel shifts, so a shift of
+//up to this many rows (longer than any line) is a load from an offset
+#define KERNEL_PAD 32
 
-/* Function used to generate a new move by placing new game piece on the board
- * Preconditions: cur_board = GameState object representing the game board,
- *                player = char either X or O to place tile piece,
- *                row = row in the gameboard, starting from top to bottom
- *                column = column in gameboard, starting from left to right
- * Postconditions: Returns a GameState object with new piece placed on board if
- *                 no errors
- */
-GameState player_gen_move(GameState cur_board, char player, unsigned int row, unsigned int column) {
-	unsigned int pos = (row*cur_board.n)+column;
-	unsigned int n = cur_board.n;
+//A bit plane padded with empty rows, rows[KERNEL_PAD + row] is board row row
+struct KernelPlane {
+	alignas(32) uint32_t rows[KERNEL_PAD + KERNEL_ROWS + KERNEL_PAD];
+};
 
-	//if there are no free tiles left on gameboard
-	if ( cur_board.game_end || cur_board.tiles_left == 0) {
-		std::cout << "Game has ended or board is filled" << std::endl;
-		return cur_board;
+//Whole board totals, the same values GameState keeps line by line
+struct KernelScores {
+	int score_x;
+	int score_o;
+	int wins_x;
+	int wins_o;
+};
+
+/* Plane operations of the board kernel, on KERNEL_ROWS rows at a time.
+ * view() copies a plane shifted so the tile k steps further along a line
+ * lands on every tile: rows by a load from an offset, columns by a bit shift.
+ */
+struct ScalarOps {
+	static void view(uint32_t *dst, const KernelPlane &src, int row_offset, int column_shift) {
+		const uint32_t *rows = src.rows + KERNEL_PAD + row_offset;
+		for (int r = 0; r < KERNEL_ROWS; r++)
+			dst[r] = (column_shift >= 0) ? rows[r] >> column_shift : rows[r] << -column_shift;
 	}
-	//checks if input row, column is accurate and if tile at pos is free
-	if (((row < 0 || row >= n) || (column < 0 || column >= n)) || cur_board.board[pos] != '.') {
-		std::cout << "Illegal move by player " << player << " at " << row << " " << column << std::endl;
+	static void and_planes(uint32_t *dst, const uint32_t *a, const uint32_t *b) {
+		for (int r = 0; r < KERNEL_ROWS; r++)
+			dst[r] = a[r] & b[r];
 	}
-	else {
-		cur_board.board[pos] = player;
-		cur_board.column_count[column] = true;
-		cur_board.tiles_left--;
-		cur_board.last_column = column;
-		cur_board.last_row = row;
+	//a and not b
+	static void andnot_planes(uint32_t *dst, const uint32_t *a, const uint32_t *b) {
+		for (int r = 0; r < KERNEL_ROWS; r++)
+			dst[r] = a[r] & ~b[r];
 	}
-	return cur_board;
-}
-
-/* Function used to generate a new random move on the game board
- * Preconditions: cur_board = GameState object representing the game board,
- *                player = char either X or O to place tile piece,
- * Postconditions: Returns a GameState object with new piece placed on board if
- *                 no errors
- */
-GameState random_gen_move(GameState cur_board, char player) {
-	unsigned int n = cur_board.n;
-
-	//if there are no free tiles left on gameboard
-	if ( cur_board.game_end || cur_board.tiles_left == 0) {
-		std::cout << "Game has ended or board is filled" << std::endl;
-		return cur_board;
+	static void or_planes(uint32_t *dst, const uint32_t *a, const uint32_t *b) {
+		for (int r = 0; r < KERNEL_ROWS; r++)
+			dst[r] = a[r] | b[r];
 	}
-	//if there exists an empty spot
-	//NOTE: As the # of free tiles becomes closer to 0,
-	//the more likely there will be collisions with occupied tiles
-	else {
-		//generates random positions for tile piece until it finds an empty one
-		int row = rand() % n;
-		int column = rand() % n;
-		char piece = cur_board.at(row, column);
-		while (piece != '.') {
-			row = rand() % n;
-			column = rand() % n;
-			piece = cur_board.at(row, column);
-		}
-		unsigned int pos = (row*cur_board.n)+column;
-		cur_board.board[pos] = player;
-		cur_board.column_count[column] = true;
-		cur_board.tiles_left--;
-		cur_board.last_column = column;
-		cur_board.last_row = row;
+	static void xor_planes(uint32_t *dst, const uint32_t *a, const uint32_t *b) {
+		for (int r = 0; r < KERNEL_ROWS; r++)
+			dst[r] = a[r] ^ b[r];
 	}
-	return cur_board;
-}
-/*
- * Preconditions: root = GameState object representing the game board,
- * Postconditions: Returns a GameState object with new piece placed on board if
- */
-std::pair<int, std::pair<int, int> > alphabeta(GameState root,
-	unsigned int depth, std::pair<int, std::pair<int, int> > alpha,
-	std::pair<int, std::pair<int, int> > beta, char player, bool maxPlayer,
-	timespec &start_time, const unsigned int &time_limit, bool &cutoff,
-	unsigned int m) {
-
-	timespec time_now;
-	clock_gettime(CLOCK_REALTIME, &time_now);
-	double time_taken = (time_now.tv_sec - start_time.tv_sec)+(time_now.tv_nsec - start_time.tv_nsec)/1000000000.0;
-	//std::cout << "TIME AT DEPTH: " << depth <<" " << time_taken << std::endl;
-	if (time_taken > time_limit) {
-		cutoff = true;
-		return alpha;
+	static int count(const uint32_t *a) {
+		int total = 0;
+		for (int r = 0; r < KERNEL_ROWS; r++)
+			total += __builtin_popcount(a[r]);
+		return total;
 	}
+};
 
-	//if cutoff, terminal node, or depth at zero
-	if ((time_taken >= time_limit) || depth == 0 || root.game_end || root.tiles_left == 0) {
-		std::pair<int, std::pair<int, int> > hscore;
-		//hscore.first = heuristics score function
-		hscore.first = root.hscore;
-
-		//if (root.game_end)
-			//(root.hscore == 5376 && root.last_row == 5&& root.last_column == 6)
-			//print_board(root);
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
 
-		//Given the choice between winning moves, we wish the pick the winning
-		//sequence that is closer to starting node in the alphabeta search
-		//higher priority is given to winning quicker. likewise, if a node is
-		//a losing one, the quicker we lose, the worst off we are
-		if (hscore.first == SCORE_WIN)
-			hscore.first += depth;
-		if (hscore.first == SCORE_LOSE)
-			hscore.first -= depth;
-		//
-		//if (root.game_end)
-		//std::cout <<"  debug: root.last_row: " << root.last_row << "root.last_column: " << root.last_column << " hscore: "<< hscore.first <<std::endl;
-		hscore.second.first = root.last_row;
-		hscore.second.second = root.last_column;
-		//if(hscore.first == SCORE_WIN){
-		//print_board(root);
-		//std::cout<<" BOARD SCORE: "<< hscore.first<<std::endl;
-
-			//std::cout <<"  debug: root.last_row: " << root.last_row << "root.last_column: " << root.last_column << " hscore: "<< hscore.first <<std::endl;
-		//}
-		return hscore;
+//4 rows per vector, popcnt for the counts
+struct Sse42Ops {
+	__attribute__((target("sse4.2")))
+	static void view(uint32_t *dst, const KernelPlane &src, int row_offset, int column_shift) {
+		const uint32_t *rows = src.rows + KERNEL_PAD + row_offset;
+		__m128i count = _mm_cvtsi32_si128(column_shift >= 0 ? column_shift : -column_shift);
+		for (int r = 0; r < KERNEL_ROWS; r += 4) {
+			__m128i v = _mm_loadu_si128((const __m128i *)(rows + r));
+			v = (column_shift >= 0) ? _mm_srl_epi32(v, count) : _mm_sll_epi32(v, count);
+			_mm_store_si128((__m128i *)(dst + r), v);
+		}
 	}
-
-	//used to flip the players for generating new moves
-	char current_player;
-	if (player == 'X') {
-		if (maxPlayer)
-			current_player = 'X';
-		else
-			current_player = 'O';
+	__attribute__((target("sse4.2")))
+	static void and_planes(uint32_t *dst, const uint32_t *a, const uint32_t *b) {
+		for (int r = 0; r < KERNEL_ROWS; r += 4)
+			_mm_store_si128((__m128i *)(dst + r), _mm_and_si128(
+				_mm_load_si128((const __m128i *)(a + r)), _mm_load_si128((const __m128i *)(b + r))));
 	}
-	else if (player == 'O') {
-		if (maxPlayer)
-			current_player = 'O';
-		else
-			current_player = 'X';
+	__attribute__((target("sse4.2")))
+	static void andnot_planes(uint32_t *dst, const uint32_t *a, const uint32_t *b) {
+		for (int r = 0; r < KERNEL_ROWS; r += 4)
+			_mm_store_si128((__m128i *)(dst + r), _mm_andnot_si128(
+				_mm_load_si128((const __m128i *)(b + r)), _mm_load_si128((const __m128i *)(a + r))));
 	}
-	else {
-		std::cout << "alphabeta error: unrecognized player" << std::endl;
-	}
-	//std::cout<<"START BOARD" << std::endl;
-	//print_board(root);
-	std::deque<GameState> moves = gen_all_moves(root, m, player, current_player);
-	//if (time_taken > time_limit) {
-	//}
-	/*
-	std::cout<< "ALPHABETA DEPTH: " << depth << " GEN PLAYER " << current_player << std::endl;
-	for (std::deque<GameState>::iterator itr = moves.begin(); itr != moves.end(); itr++) {
-		print_board(*itr);
-		std::cout << "LAST MOVE: " << itr->last_row << ", " << itr->last_column << " SCORE: " << itr->hscore <<std::endl;
-	}*/
-
-	if (maxPlayer) {
-		for (std::deque<GameState>::iterator itr = moves.begin(); itr != moves.end(); itr++) {
-			std::pair<int, std::pair<int, int> > temp_score;
-			//
-			//if (depth == 1){
-				//print_board(*itr);
-				//std::cout<<" BOARD SCORE: "<< *itr.first<<std::endl;
-				//}
-			//
-			temp_score = alphabeta(*itr, depth-1, alpha, beta, player, false, start_time, time_limit, cutoff, m);
-			if (cutoff) {
-				return alpha;
-			}
-			if (temp_score.first > alpha.first) {
-				alpha.first = temp_score.first;
-				alpha.second.first = itr->last_row;
-				alpha.second.second = itr->last_column;
-				//if (depth == 3)
-					//std::cout <<"  changing alpha: last_row: " << alpha.second.first << "last_column: " << alpha.second.second << " hscore: "<< alpha.first <<std::endl;
-
-			}
-			//if (depth == 5)
-				//std::cout <<"  debug: root.last_row: " << alpha.second.first << "root.last_column: " << alpha.second.second << " hscore: "<< alpha.first <<std::endl;
-
-			if (alpha.first >= beta.first)
-				break;
-		}/*
-		if (depth == 3) {
-			std::cout <<"  debug: root.last_row: " << alpha.second.first << "root.last_column: " << alpha.second.second << " hscore: "<< alpha.first <<std::endl;
-		}*/
-
-		return alpha;
+	__attribute__((target("sse4.2")))
+	static void or_planes(uint32_t *dst, const uint32_t *a, const uint32_t *b) {
+		for (int r = 0; r < KERNEL_ROWS; r += 4)
+			_mm_store_si128((__m128i *)(dst + r), _mm_or_si128(
+				_mm_load_si128((const __m128i *)(a + r)), _mm_load_si128((const __m128i *)(b + r))));
 	}
-	else {
-		for (std::deque<GameState>::iterator itr = moves.begin(); itr != moves.end(); itr++) {
-			std::pair<int, std::pair<int, int> > temp_score;
-			temp_score = alphabeta(*itr, depth-1, alpha, beta, player, true, start_time, time_limit, cutoff, m);
-			if (cutoff) {
-				return beta;
-			}
-			if (temp_score.first < beta.first) {
-				beta.first = temp_score.first;
-				beta.second.first = itr->last_row;
-				beta.second.second = itr->last_column;
-				if (depth == 3)
-					std::cout <<"  changing beta: last_row: " << alpha.second.first << "last_column: " << alpha.second.second << " hscore: "<< alpha.first <<std::endl;
+	__attribute__((target("sse4.2")))
+	static void xor_planes(uint32_t *dst, const uint32_t *a, const uint32_t *b) {
+		for (int r = 0; r < KERNEL_ROWS; r += 4)
+			_mm_store_si128((__m128i *)(dst + r), _mm_xor_si128(
+				_mm_load_si128((const __m128i *)(a + r)), _mm_load_si128((const __m128i *)(b + r))));
+	}
+	__attribute__((target("sse4.2")))
+	static int count(const uint32_t *a) {
+		//the 32 bit popcnt, since 32 bit x86 has no _mm_popcnt_u64
+		int total = 0;
+		for (int r = 0; r < KERNEL_ROWS; r++)
+			total += _mm_popcnt_u32(a[r]);
+		return total;
+	}
+};
 
-			}
-			if (alpha.first >= beta.first)
-				break;
+//8 rows per vector
+struct Avx2Ops {
+	__attribute__((target("avx2,popcnt")))
+	static void view(uint32_t *dst, const KernelPlane &src, int row_offset, int column_shift) {
+		const uint32_t *rows = src.rows + KERNEL_PAD + row_offset;
+		__m128i count = _mm_cvtsi32_si128(column_shift >= 0 ? column_shift : -column_shift);
+		for (int r = 0; r < KERNEL_ROWS; r += 8) {
+			__m256i v = _mm256_loadu_si256((const __m256i *)(rows + r));
+			v = (column_shift >= 0) ? _mm256_srl_epi32(v, count) : _mm256_sll_epi32(v, count);
+			_mm256_store_si256((__m256i *)(dst + r), v);
 		}
-		return beta;
 	}
-}
-std::pair<int, int> itr_deep_minimax(GameState root, char player, const unsigned int time_limit, unsigned int m) {
-	timespec start;
-	//timespec prog_start, prog_end;
-	std::pair<int, std::pair<int, int> > alpha, beta;
-	std::pair<int, int> r_move;
-	alpha.first = ALPHA_INF;
-	beta.first = BETA_INF;
-	unsigned int depth = 1;
-	bool cutoff = false;
-	std::pair<int, std::pair<int, int> > best_move;
-	best_move.first = 0;
-	best_move.second.first = -1;
-	best_move.second.second = -1;
+	__attribute__((target("avx2,popcnt")))
+	static void and_planes(uint32_t *dst, const uint32_t *a, const uint32_t *b) {
+		for (int r = 0; r < KERNEL_ROWS; r += 8)
+			_mm256_store_si256((__m256i *)(dst + r), _mm256_and_si256(
+				_mm256_load_si256((const __m256i *)(a + r)), _mm256_load_si256((const __m256i *)(b + r))));
+	}
+	__attribute__((target("avx2,popcnt")))
+	static void andnot_planes(uint32_t *dst, const uint32_t *a, const uint32_t *b) {
+		for (int r = 0; r < KERNEL_ROWS; r += 8)
+			_mm256_store_si256((__m256i *)(dst + r), _mm256_andnot_si256(
+				_mm256_load_si256((const __m256i *)(b + r)), _mm256_load_si256((const __m256i *)(a + r))));
+	}
+	__attribute__((target("avx2,popcnt")))
+	static void or_planes(uint32_t *dst, const uint32_t *a, const uint32_t *b) {
+		for (int r = 0; r < KERNEL_ROWS; r += 8)
+			_mm256_store_si256((__m256i *)(dst + r), _mm256_or_si256(
+				_mm256_load_si256((const __m256i *)(a + r)), _mm256_load_si256((const __m256i *)(b + r))));
+	}
+	__attribute__((target("avx2,popcnt")))
+	static void xor_planes(uint32_t *dst, const uint32_t *a, const uint32_t *b) {
+		for (int r = 0; r < KERNEL_ROWS; r += 8)
+			_mm256_store_si256((__m256i *)(dst + r), _mm256_xor_si256(
+				_mm256_load_si256((const __m256i *)(a + r)), _mm256_load_si256((const __m256i *)(b + r))));
+	}
+	__attribute__((target("avx2,popcnt")))
+	static int count(const uint32_t *a) {
+		int total = 0;
+		for (int r = 0; r < KERNEL_ROWS; r++)
+			total += _mm_popcnt_u32(a[r]);
+		return total;
+	}
+};
+#endif
+
+/* Scores the patterns of one player in one direction for the whole board at
+ * once.  Every run of own pieces is found on its starting tile, and the runs
+ * of each length are counted with their empty ends by shifting the planes
+ * along the line and masking them together.
+ * Preconditions: own, opp and empty = padded planes of the board, empty only
+ *                has tiles on the board, dr/dc = step along the line
+ * Postconditions: Adds the player's patterns to own_score, opp_score (the
+ *                 other player's perspective) and wins
+ */
+template <class Ops>
+void kernel_direction(const KernelPlane &own, const KernelPlane &empty, unsigned int m,
+	int dr, int dc, bool diagonal, int &own_score, int &opp_score, int &wins) {
+	alignas(32) uint32_t run[KERNEL_ROWS], next[KERNEL_ROWS], exact[KERNEL_ROWS];
+	alignas(32) uint32_t before1[KERNEL_ROWS], before2[KERNEL_ROWS];
+	alignas(32) uint32_t after1[KERNEL_ROWS], after2[KERNEL_ROWS], tmp[KERNEL_ROWS];
+	//run = tiles that start a run of own pieces
+	Ops::view(tmp, own, -dr, -dc);
+	Ops::andnot_planes(run, own.rows + KERNEL_PAD, tmp);
+	Ops::view(before1, empty, -dr, -dc);
+	Ops::view(before2, empty, -2*dr, -2*dc);
+	//no run is longer than the board, which also keeps every shift inside
+	//the padding
+	for (unsigned int size = 1; size <= m+1 && size <= MAX_BOARD_LIMIT; size++) {
+		if (size > m) {
+			int over = Ops::count(run);
+			own_score += over * SCORE_OVER;
+			opp_score += over * SCORE_OPP_OVER;
+			break;
+		}
+		//exact = runs of exactly size pieces
+		Ops::view(next, own, size*dr, size*dc);
+		Ops::andnot_planes(exact, run, next);
+		if (size == m) {
+			wins += Ops::count(exact);
+		}
+		else if (size == m-1 || size == m-2) {
+			Ops::view(after1, empty, size*dr, size*dc);
+			Ops::view(after2, empty, (size+1)*dr, (size+1)*dc);
+			//runs with 2 empty ends, and with 1
+			Ops::and_planes(tmp, before1, after1);
+			Ops::and_planes(tmp, tmp, exact);
+			int two_ends = Ops::count(tmp);
+			Ops::xor_planes(tmp, before1, after1);
+			Ops::and_planes(tmp, tmp, exact);
+			int one_end = Ops::count(tmp);
+			int no_ends = Ops::count(exact) - two_ends - one_end;
+			if (size == m-1) {
+				own_score += one_end * SCORE_M + two_ends * SCORE_STRAIGHT_M + no_ends * SCORE_DEADEND;
+				opp_score += one_end * SCORE_OPP_M + two_ends * SCORE_OPP_STRAIGHT_M + no_ends * SCORE_OPP_DEADEND;
+			}
+			else {
+				//2 empty ends only make an m minus with another empty tile
+				//past one of them, the rest score as deadends
+				Ops::or_planes(tmp, before2, after2);
+				Ops::and_planes(tmp, tmp, before1);
+				Ops::and_planes(tmp, tmp, after1);
+				Ops::and_planes(tmp, tmp, exact);
+				int m_minus = Ops::count(tmp);
+				no_ends += two_ends - m_minus;
+				own_score += m_minus * SCORE_M_MINUS + no_ends * SCORE_DEADEND + one_end * (int)size;
+				//the diagonal quirk of pattern_score
+				opp_score += m_minus * SCORE_OPP_M_MINUS + no_ends * SCORE_OPP_DEADEND
+					+ one_end * (diagonal ? (int)size : -(int)size);
+			}
+		}
+		else {
+			int runs = Ops::count(exact);
+			own_score += runs * (int)size;
+			opp_score -= runs * (int)size;
+		}
+		//runs at least size+1 long
+		Ops::and_planes(run, run, next);
+	}
+}
+
+/* Scores the whole board from scratch with the plane operations of Ops
+ * Postconditions: Returns the totals GameState keeps for board
+ */
+template <class Ops>
+KernelScores kernel_scores(const GameState &board) {
+	KernelPlane x_plane, o_plane, empty_plane;
+	for (int r = 0; r < KERNEL_PAD + KERNEL_ROWS + KERNEL_PAD; r++) {
+		x_plane.rows[r] = 0;
+		o_plane.rows[r] = 0;
+		empty_plane.rows[r] = 0;
+	}
+	for (unsigned int r = 0; r < board.n; r++) {
+		x_plane.rows[KERNEL_PAD + r] = board.x_rows[r];
+		o_plane.rows[KERNEL_PAD + r] = board.o_rows[r];
+		empty_plane.rows[KERNEL_PAD + r] = ~(board.x_rows[r] | board.o_rows[r]) & board.row_mask();
+	}
+	//steps along the lines of DIR_DOWN, DIR_RIGHT, DIR_TOPR and DIR_BOTR
+	const int steps[4][2] = {{1, 0}, {0, 1}, {-1, 1}, {1, 1}};
+	KernelScores out;
+	out.score_x = 0;
+	out.score_o = 0;
+	out.wins_x = 0;
+	out.wins_o = 0;
+	for (int dir = 0; dir < 4; dir++) {
+		bool diagonal = (dir == DIR_TOPR || dir == DIR_BOTR);
+		kernel_direction<Ops>(x_plane, empty_plane, board.m, steps[dir][0], steps[dir][1],
+			diagonal, out.score_x, out.score_o, out.wins_x);
+		kernel_direction<Ops>(o_plane, empty_plane, board.m, steps[dir][0], steps[dir][1],
+			diagonal, out.score_o, out.score_x, out.wins_o);
+	}
+	return out;
+}
+
+//flatten inlines the kernel and its plane operations into each version, so
+//they are compiled for that version's instruction set
+__attribute__((flatten))
+KernelScores kernel_scores_scalar(const GameState &board) {
+	return kernel_scores<ScalarOps>(board);
+}
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse4.2"), flatten))
+KernelScores kernel_scores_sse42(const GameState &board) {
+	return kernel_scores<Sse42Ops>(board);
+}
+__attribute__((target("avx2,popcnt"), flatten))
+KernelScores kernel_scores_avx2(const GameState &board) {
+	return kernel_scores<Avx2Ops>(board);
+}
+#endif
+
+//A version of the board kernel and the name it is reported by
+struct BoardKernel {
+	const char *name;
+	KernelScores (*scores)(const GameState &board);
+	bool supported;
+};
+
+//every version of the kernel built into the program, best first
+std::vector<BoardKernel> board_kernels() {
+	std::vector<BoardKernel> kernels;
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	BoardKernel avx2 = {"avx2", kernel_scores_avx2, __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")};
+	BoardKernel sse42 = {"sse4.2", kernel_scores_sse42, (bool)__builtin_cpu_supports("sse4.2")};
+	kernels.push_back(avx2);
+	kernels.push_back(sse42);
+#endif
+	BoardKernel scalar = {"scalar", kernel_scores_scalar, true};
+	kernels.push_back(scalar);
+	return kernels;
+}
+
+//the best kernel the cpu supports, picked once from CPUID
+const BoardKernel &board_kernel() {
+	static const BoardKernel best = []() {
+		std::vector<BoardKernel> kernels = board_kernels();
+		for (size_t i = 0; i < kernels.size(); i++) {
+			if (kernels[i].supported)
+				return kernels[i];
+		}
+		return kernels.back();
+	}();
+	return best;
+}
+
+/* Scores the board from the line scores GameState keeps up to date on every
+ * set(), so only the 4 lines through each move are ever rescanned.
+ * Preconditions: node = game board, m = # of tiles in a row to match,
+ *                cur_player = player's perspective for the score
+ * Postconditions: Returns node with hscore and game_end set
+ */
+GameState heuristics_func(GameState node, const int m, const char cur_player) {
+	node.evaluate(cur_player);
+	//m is only needed by the full scan check below
+	(void)m;
+#ifdef DEBUG_EVAL
+	GameState check = heuristics_full_scan(node, m, cur_player);
+	if (check.hscore != node.hscore || check.game_end != node.game_end) {
+		std::cerr << "heuristics_func mismatch: incremental " << node.hscore
+		          << " full scan " << check.hscore << std::endl;
+		print_board(node);
+		abort();
+	}
+	KernelScores kernel = board_kernel().scores(node);
+	if (kernel.score_x != node.total_x || kernel.score_o != node.total_o
+		|| kernel.wins_x != node.wins_x || kernel.wins_o != node.wins_o) {
+		std::cerr << "heuristics_func mismatch: " << board_kernel().name << " kernel "
+		          << kernel.score_x << " " << kernel.score_o << " incremental "
+		          << node.total_x << " " << node.total_o << std::endl;
+		print_board(node);
+		abort();
+	}
+	for (unsigned int sym = 0; sym < 8; sym++) {
+		if (symmetry_key(node, sym) != node.sym_keys[sym] || node.sym_keys[0] != node.key) {
+			std::cerr << "symmetry key " << sym << " mismatch" << std::endl;
+			print_board(node);
+			abort();
+		}
+	}
+#endif
+	return node;
+}
+
+//Most moves a position can have, every tile of the largest board
+#define MAX_MOVES (MAX_BOARD_LIMIT*MAX_BOARD_LIMIT)
+
+//Fixed capacity list of (row, column) moves, kept on the stack so generating
+//the moves of a node never allocates
+struct MoveList {
+	typedef std::pair<int, int> *iterator;
+	std::pair<int, int> moves[MAX_MOVES];
+	unsigned int count;
+
+	MoveList(): count(0) {}
+
+	void push_back(const std::pair<int, int> &move) {
+		moves[count++] = move;
+	}
+	unsigned int size() const {
+		return count;
+	}
+	bool empty() const {
+		return count == 0;
+	}
+	std::pair<int, int> &operator[](unsigned int i) {
+		return moves[i];
+	}
+	const std::pair<int, int> &operator[](unsigned int i) const {
+		return moves[i];
+	}
+	iterator begin() {
+		return moves;
+	}
+	iterator end() {
+		return moves + count;
+	}
+};
+
+/* Generates the tiles to place a new piece on, every empty tile within radius
+ * of an existing piece on the board.  The search makes and unmakes each of
+ * them on a single board instead of generating a copy of the board per move.
+ * Preconditions: cur_board = node, radius = 1 for the tiles next to a piece,
+ *                2 to also reach the tiles past a gap
+ * Postconditions: move_list = (row, column) tiles, row by row from left to
+ *                 right
+ */
+template <unsigned int N=0>
+void gen_all_moves(const GameState &cur_board, MoveList &move_list, unsigned int radius=1) {
+	move_list.count = 0;
+	int board_column_size = N ? N : cur_board.n;
+	//gen_mask holds every empty tile near an existing piece, built from the
+	//shifted copies of the board
+	uint32_t gen_mask[MAX_BOARD_LIMIT];
+	cur_board.neighbors<N>(gen_mask, radius);
+	//if the board is empty, pick the middle tile to generate new state
+	if (cur_board.column_mask == 0) {
+		int middle_board = board_column_size/2;
+		gen_mask[middle_board] |= 1u << middle_board;
+	}
+	for (int j = 0; j < board_column_size; j++) {
+		uint32_t row_bits = gen_mask[j];
+		while (row_bits) {
+			int i = __builtin_ctz(row_bits);
+			row_bits &= row_bits - 1;
+			move_list.push_back(std::pair<int, int>(j, i));
+		}
+	}
+}
+
+/* Function used to generate a new move by placing new game piece on the board
+ * Preconditions: cur_board = GameState object representing the game board,
+ *                player = char either X or O to place tile piece,
+ *                row = row in the gameboard, starting from top to bottom
+ *                column = column in gameboard, starting from left to right
+ * Postconditions: Returns a GameState object with new piece placed on board if
+ *                 no errors
+ */
+GameState player_gen_move(GameState cur_board, char player, unsigned int row, unsigned int column) {
+	unsigned int n = cur_board.n;
+
+	//if there are no free tiles left on gameboard
+	if ( cur_board.game_end || cur_board.tiles_left == 0) {
+		std::cout << "Game has ended or board is filled" << std::endl;
+		return cur_board;
+	}
+	//checks if input row, column is accurate and if tile at pos is free
+	if (((row < 0 || row >= n) || (column < 0 || column >= n)) || cur_board.at(row, column) != '.') {
+		std::cout << "Illegal move by player " << player << " at " << row << " " << column << std::endl;
+	}
+	else {
+		cur_board.set(row, column, player);
+	}
+	return cur_board;
+}
+
+/* Function used to generate a new random move on the game board
+ * Preconditions: cur_board = GameState object representing the game board,
+ *                player = char either X or O to place tile piece,
+ *                random = the game's random number generator
+ * Postconditions: Returns a GameState object with new piece placed on board if
+ *                 no errors
+ */
+GameState random_gen_move(GameState cur_board, char player, Xoshiro &random) {
+	//if there are no free tiles left on gameboard
+	if ( cur_board.game_end || cur_board.tiles_left == 0) {
+		std::cout << "Game has ended or board is filled" << std::endl;
+		return cur_board;
+	}
+	//picks straight from the empty tiles, so a nearly full board takes no
+	//longer than an empty one
+	else {
+		unsigned int tile = cur_board.empty.sample(random);
+		cur_board.set(tile / MAX_BOARD_LIMIT, tile % MAX_BOARD_LIMIT, player);
+	}
+	return cur_board;
+}
+//# of nodes searched between looks at the clock, a power of two
+#define TIME_CHECK_NODES 1024
+//share of the time limit after which no new iteration is started
+#define TIME_SOFT_SHARE 0.5
+//growth in time from one iteration to the next assumed before two
+//iterations have been timed, and the least growth ever assumed
+#define TIME_DEFAULT_GROWTH 10.0
+#define TIME_MIN_GROWTH 2.0
+
+//CLOCK_MONOTONIC in seconds
+double monotonic_seconds() {
+	timespec time_now;
+	clock_gettime(CLOCK_MONOTONIC, &time_now);
+	return time_now.tv_sec + time_now.tv_nsec / 1000000000.0;
+}
+
+/* Clock of a search, read from CLOCK_MONOTONIC so it cannot jump when the
+ * system time is set.  The hard limit ends the search wherever it is, the
+ * soft limit only stops new iterations from starting.  The limits run from
+ * reset(), or from *limits_from (a monotonic_seconds() time another thread
+ * may move, see Ponder) when it is set
+ */
+struct TimeManager {
+	timespec start;
+	double soft_limit;
+	double hard_limit;
+	const std::atomic<double> *limits_from;
+
+	TimeManager(double hard=1, double soft_share=TIME_SOFT_SHARE):
+		soft_limit(hard * soft_share), hard_limit(hard), limits_from(NULL) {
+		reset();
+	}
+
+	void reset() {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+	}
+
+	//seconds since reset()
+	double elapsed() const {
+		timespec time_now;
+		clock_gettime(CLOCK_MONOTONIC, &time_now);
+		return (time_now.tv_sec - start.tv_sec)+(time_now.tv_nsec - start.tv_nsec)/1000000000.0;
+	}
+
+	//seconds the limits are measured against
+	double limit_elapsed() const {
+		if (limits_from)
+			return monotonic_seconds() - limits_from->load(std::memory_order_relaxed);
+		return elapsed();
+	}
+
+	bool hard_expired() const {
+		return limit_elapsed() > hard_limit;
+	}
+
+	/* Whether another iteration is worth starting, given how long the last
+	 * two took: the next is predicted to take last_time times as much again
+	 * as last_time took over prev_time, and is not started if it would run
+	 * past the hard limit and be thrown away
+	 */
+	bool next_iteration(double prev_time, double last_time) const {
+		double now = limit_elapsed();
+		if (now > soft_limit)
+			return false;
+		double growth = TIME_DEFAULT_GROWTH;
+		if (prev_time > 0)
+			growth = std::max(last_time / prev_time, TIME_MIN_GROWTH);
+		return now + last_time * growth <= hard_limit;
+	}
+};
+
+//Default limits of the threat space search run before itr_deep_minimax, in
+//attacker moves
+#define TSS_VCF_DEPTH 12
+#define TSS_VCT_DEPTH 4
+
+//Result of a threat space search
+struct ThreatResult {
+	//true if a forced win was proven
+	bool found;
+	//first move of the win
+	std::pair<int, int> move;
+	//attacker and defender moves of the winning line, starting with move and
+	//ending with the winning move, one defence is shown for each three
+	std::vector< std::pair<int, int> > sequence;
+	unsigned long long nodes;
+	//true if the node or time budget ran out before the search finished
+	bool out_of_budget;
+};
+
+/* Threat space search (Allis et al.) for the variable m.  Only forcing moves
+ * are searched: the attacker only plays moves that make an m threat (a tile
+ * that wins on the next move, a "four") or, for VCT, moves after which the
+ * attacker can make two m threats at once (a "three").  The defender only
+ * plays the moves that stop those threats, or makes m threats of their own.
+ */
+struct ThreatSearch {
+	char attacker;
+	char defender;
+	bool vct;
+	unsigned long long node_budget;
+	TimeManager timer;
+	//set by another thread to end the search early, NULL for none
+	const std::atomic<bool> *stop;
+	unsigned long long nodes;
+	bool out_of_budget;
+	std::vector< std::pair<int, int> > line;
+	std::vector< std::pair<int, int> > win_line;
+
+	//threats only look at the bit planes, so pieces are put down and taken
+	//back without the line rescoring of set() on the search's own board
+	static void flip(GameState &board, int row, int column, char player) {
+		if (player == 'X')
+			board.x_rows[row] ^= 1u << column;
+		else
+			board.o_rows[row] ^= 1u << column;
+	}
+
+	//empty tiles where player's piece makes exactly m in a row, since a
+	//winning tile is next to one of player's pieces only those are checked
+	void win_tiles(const GameState &board, char player, std::vector< std::pair<int, int> > &out) {
+		out.clear();
+		const uint32_t *own = (player == 'X') ? board.x_rows : board.o_rows;
+		uint32_t near[MAX_BOARD_LIMIT];
+		dilate_plane(own, near, board.n, 1);
+		for (unsigned int r = 0; r < board.n; r++) {
+			uint32_t bits = near[r] & ~(board.x_rows[r] | board.o_rows[r]);
+			while (bits) {
+				int c = __builtin_ctz(bits);
+				bits &= bits - 1;
+				if (board.wins_at(r, c, player))
+					out.push_back(std::pair<int, int>(r, c));
+			}
+		}
+	}
+
+	//empty tiles on the 4 lines through (row, column), up to m-1 away, where
+	//player's piece makes exactly m in a row.  When player had no winning
+	//tile before a piece was put on (row, column), these are all of them
+	void line_win_tiles(const GameState &board, int row, int column, char player,
+		std::vector< std::pair<int, int> > &out) {
+		static const int steps[4][2] = {{1, 0}, {0, 1}, {-1, 1}, {1, 1}};
+		out.clear();
+		for (int dir = 0; dir < 4; dir++) {
+			for (int side = -1; side <= 1; side += 2) {
+				int r = row, c = column;
+				for (unsigned int k = 1; k < board.m; k++) {
+					r += side*steps[dir][0];
+					c += side*steps[dir][1];
+					if (r < 0 || r >= (int)board.n || c < 0 || c >= (int)board.n)
+						break;
+					if (board.at(r, c) == '.' && board.wins_at(r, c, player))
+						out.push_back(std::pair<int, int>(r, c));
+				}
+			}
+		}
+		std::sort(out.begin(), out.end());
+		out.erase(std::unique(out.begin(), out.end()), out.end());
+	}
+
+	//empty tiles on the 4 lines through (row, column), up to m-1 away
+	void line_tiles(const GameState &board, int row, int column,
+		std::vector< std::pair<int, int> > &out) {
+		static const int steps[4][2] = {{1, 0}, {0, 1}, {-1, 1}, {1, 1}};
+		out.clear();
+		for (int dir = 0; dir < 4; dir++) {
+			for (int side = -1; side <= 1; side += 2) {
+				int r = row, c = column;
+				for (unsigned int k = 1; k < board.m; k++) {
+					r += side*steps[dir][0];
+					c += side*steps[dir][1];
+					if (r < 0 || r >= (int)board.n || c < 0 || c >= (int)board.n)
+						break;
+					if (board.at(r, c) == '.')
+						out.push_back(std::pair<int, int>(r, c));
+				}
+			}
+		}
+	}
+
+	//empty tiles within 2 of player's pieces, every tile that can make a new
+	//threat for player is one of them
+	void threat_candidates(const GameState &board, char player, std::vector< std::pair<int, int> > &out) {
+		out.clear();
+		const uint32_t *own = (player == 'X') ? board.x_rows : board.o_rows;
+		uint32_t near[MAX_BOARD_LIMIT];
+		dilate_plane(own, near, board.n, 2);
+		for (unsigned int r = 0; r < board.n; r++) {
+			uint32_t bits = near[r] & ~(board.x_rows[r] | board.o_rows[r]);
+			while (bits) {
+				int c = __builtin_ctz(bits);
+				bits &= bits - 1;
+				out.push_back(std::pair<int, int>(r, c));
+			}
+		}
+	}
+
+	bool budget_left() {
+		if (out_of_budget)
+			return false;
+		if (node_budget && nodes >= node_budget)
+			out_of_budget = true;
+		else if ((nodes & 255) == 0 && (timer.hard_expired() || (stop && stop->load(std::memory_order_relaxed))))
+			out_of_budget = true;
+		return !out_of_budget;
+	}
+
+	/* Defender has just been forced by a three, every reply in replies has
+	 * to lose for the three to win
+	 */
+	bool all_replies_lose(GameState &board, const std::vector< std::pair<int, int> > &replies, unsigned int depth) {
+		for (size_t i = 0; i < replies.size(); i++) {
+			flip(board, replies[i].first, replies[i].second, defender);
+			line.push_back(replies[i]);
+			bool won = attack(board, depth);
+			line.pop_back();
+			flip(board, replies[i].first, replies[i].second, defender);
+			if (!won)
+				return false;
+		}
+		return true;
+	}
+
+	/* Attacker to move, depth = # of attacker moves left
+	 * Postconditions: Returns true if the attacker has a forced win, win_line
+	 *                 holds the line that was found
+	 */
+	bool attack(GameState &board, unsigned int depth) {
+		nodes++;
+		if (!budget_left())
+			return false;
+		std::vector< std::pair<int, int> > wins;
+		win_tiles(board, attacker, wins);
+		if (!wins.empty()) {
+			win_line = line;
+			win_line.push_back(wins[0]);
+			return true;
+		}
+		std::vector< std::pair<int, int> > defender_wins;
+		win_tiles(board, defender, defender_wins);
+		if (defender_wins.size() >= 2 || depth == 0)
+			return false;
+		std::vector< std::pair<int, int> > candidates;
+		//a defender threat has to be blocked, and the block still has to be
+		//a threat of the attacker's own to keep the initiative
+		if (defender_wins.size() == 1)
+			candidates = defender_wins;
+		else
+			threat_candidates(board, attacker, candidates);
+		for (size_t i = 0; i < candidates.size(); i++) {
+			int row = candidates[i].first;
+			int column = candidates[i].second;
+			flip(board, row, column, attacker);
+			line.push_back(candidates[i]);
+			line_win_tiles(board, row, column, attacker, wins);
+			bool won = false;
+			if (wins.size() >= 2) {
+				//two threats can not both be blocked
+				win_line = line;
+				win_line.push_back(wins[0]);
+				win_line.push_back(wins[1]);
+				won = true;
+			}
+			else if (wins.size() == 1) {
+				//a four, the defender's only move is to block it
+				flip(board, wins[0].first, wins[0].second, defender);
+				line.push_back(wins[0]);
+				won = attack(board, depth-1);
+				line.pop_back();
+				flip(board, wins[0].first, wins[0].second, defender);
+			}
+			else if (vct && depth >= 2) {
+				//a three, find the tiles that would give two threats next move.
+				//Only tiles on the lines of the new piece are tried, which can
+				//only leave the defender fewer replies to check
+				std::vector< std::pair<int, int> > follow_ups, replies, next_wins;
+				line_tiles(board, row, column, follow_ups);
+				for (size_t j = 0; j < follow_ups.size(); j++) {
+					flip(board, follow_ups[j].first, follow_ups[j].second, attacker);
+					line_win_tiles(board, follow_ups[j].first, follow_ups[j].second, attacker, next_wins);
+					flip(board, follow_ups[j].first, follow_ups[j].second, attacker);
+					if (next_wins.size() >= 2) {
+						replies.push_back(follow_ups[j]);
+						replies.insert(replies.end(), next_wins.begin(), next_wins.end());
+					}
+				}
+				if (!replies.empty()) {
+					//the defender may also answer with a four of their own
+					std::vector< std::pair<int, int> > counters;
+					threat_candidates(board, defender, counters);
+					for (size_t j = 0; j < counters.size(); j++) {
+						if (board.at(counters[j].first, counters[j].second) != '.')
+							continue;
+						flip(board, counters[j].first, counters[j].second, defender);
+						line_win_tiles(board, counters[j].first, counters[j].second, defender, next_wins);
+						flip(board, counters[j].first, counters[j].second, defender);
+						if (!next_wins.empty())
+							replies.push_back(counters[j]);
+					}
+					std::sort(replies.begin(), replies.end());
+					replies.erase(std::unique(replies.begin(), replies.end()), replies.end());
+					won = all_replies_lose(board, replies, depth-1);
+				}
+			}
+			line.pop_back();
+			flip(board, row, column, attacker);
+			if (won)
+				return true;
+			if (out_of_budget)
+				return false;
+		}
+		return false;
+	}
+};
+
+/* Searches for a forced win made only of forcing moves, by continuous m
+ * threats (VCF) or, if vct, by continuous threats (VCT).  Searches
+ * 1, 2, ... up to max_depth attacker moves so the shortest win is found.
+ * Preconditions: board = game board with attacker to move,
+ *                node_budget = max # of nodes (0 = no limit),
+ *                time_budget = max seconds to search, stop = flag that
+ *                ends the search when set, or NULL
+ * Postconditions: Returns whether a win was found, with its first move
+ */
+ThreatResult threat_space_search(GameState board, char attacker, bool vct, unsigned int max_depth,
+	unsigned long long node_budget, double time_budget, const std::atomic<bool> *stop=NULL) {
+	ThreatSearch search;
+	search.attacker = attacker;
+	search.defender = (attacker == 'X') ? 'O' : 'X';
+	search.vct = vct;
+	search.node_budget = node_budget;
+	search.timer = TimeManager(time_budget);
+	search.stop = stop;
+	search.nodes = 0;
+	search.out_of_budget = false;
+	ThreatResult result;
+	result.found = false;
+	result.move = std::pair<int, int>(-1, -1);
+	if (!board.game_end) {
+		for (unsigned int depth = 1; depth <= max_depth && !result.found && !search.out_of_budget; depth++) {
+			if (search.attack(board, depth)) {
+				result.found = true;
+				result.sequence = search.win_line;
+				result.move = result.sequence[0];
+			}
+		}
+	}
+	result.nodes = search.nodes;
+	result.out_of_budget = search.out_of_budget;
+	return result;
+}
+
+//Bound types of transposition table scores
+#define BOUND_EXACT 0
+#define BOUND_LOWER 1
+#define BOUND_UPPER 2
+//Default transposition table size in MB
+#define TT_DEFAULT_MB 64
+//Row/column stored for entries without a best move
+#define TT_NO_MOVE 31
+
+//One transposition table slot, data packs the score, depth, bound, best move
+//and the search generation that stored it.  key holds the position key xored
+//with data, so a slot half written by another thread fails the key check
+//instead of handing back another position's data
+struct TTEntry {
+	std::atomic<uint64_t> key;
+	std::atomic<uint64_t> data;
+};
+
+//Unpacked transposition table data
+struct TTData {
+	int score;
+	unsigned int depth;
+	int bound;
+	int row;
+	int column;
+};
+
+/* Fixed size transposition table, shared without locks by the search
+ * threads.  The table is a power of two number of buckets of 2 entries: the
+ * first keeps the deepest search of the bucket, the second is always
+ * replaced.
+ */
+struct TransTable {
+	std::vector<TTEntry> entries;
+	uint64_t bucket_mask;
+	unsigned int generation;
+
+	TransTable(unsigned int size_mb=TT_DEFAULT_MB): bucket_mask(0), generation(0) {
+		resize(size_mb);
+	}
+
+	//size_mb of 0 leaves the table empty, every probe misses
+	void resize(unsigned int size_mb) {
+		uint64_t bytes = (uint64_t)size_mb << 20;
+		uint64_t buckets = 1;
+		while (buckets * 2 * 2 * sizeof(TTEntry) <= bytes)
+			buckets *= 2;
+		std::vector<TTEntry>().swap(entries);
+		bucket_mask = 0;
+		if (size_mb > 0) {
+			std::vector<TTEntry>(buckets * 2).swap(entries);
+			bucket_mask = buckets - 1;
+			clear();
+		}
+	}
+
+	void clear() {
+		for (size_t i = 0; i < entries.size(); i++) {
+			entries[i].key.store(0, std::memory_order_relaxed);
+			entries[i].data.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	//called before each search so entries of older searches get replaced
+	void new_search() {
+		generation = (generation + 1) & 63;
+	}
+
+	static uint64_t pack(int score, unsigned int depth, int bound, int row, int column, unsigned int gen) {
+		return (uint64_t)(uint32_t)score | ((uint64_t)(depth & 255) << 32)
+			| ((uint64_t)bound << 40) | ((uint64_t)(row & 31) << 42)
+			| ((uint64_t)(column & 31) << 47) | ((uint64_t)gen << 52);
+	}
+
+	static TTData unpack(uint64_t data) {
+		TTData out;
+		out.score = (int)(uint32_t)data;
+		out.depth = (data >> 32) & 255;
+		out.bound = (data >> 40) & 3;
+		out.row = (data >> 42) & 31;
+		out.column = (data >> 47) & 31;
+		if (out.row == TT_NO_MOVE) {
+			out.row = -1;
+			out.column = -1;
+		}
+		return out;
+	}
+
+	bool probe(uint64_t key, TTData &out) const {
+		if (entries.empty())
+			return false;
+		const TTEntry *bucket = &entries[(key & bucket_mask) * 2];
+		for (int i = 0; i < 2; i++) {
+			uint64_t data = bucket[i].data.load(std::memory_order_relaxed);
+			uint64_t stored_key = bucket[i].key.load(std::memory_order_relaxed) ^ data;
+			if (stored_key == key && data != 0) {
+				out = unpack(data);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void store(uint64_t key, int score, unsigned int depth, int bound, int row, int column) {
+		if (entries.empty())
+			return;
+		if (row < 0) {
+			row = TT_NO_MOVE;
+			column = TT_NO_MOVE;
+		}
+		TTEntry *bucket = &entries[(key & bucket_mask) * 2];
+		uint64_t data = pack(score, depth, bound, row, column, generation);
+		uint64_t old_data = bucket[0].data.load(std::memory_order_relaxed);
+		uint64_t old_key = bucket[0].key.load(std::memory_order_relaxed) ^ old_data;
+		unsigned int old_depth = (old_data >> 32) & 255;
+		unsigned int old_gen = (old_data >> 52) & 63;
+		//deeper searches, the same position or entries from an old search
+		//take the depth preferred slot, the rest go to the always replace one
+		TTEntry *slot = &bucket[1];
+		if (old_key == key || depth >= old_depth || old_gen != generation)
+			slot = &bucket[0];
+		slot->key.store(key ^ data, std::memory_order_relaxed);
+		slot->data.store(data, std::memory_order_relaxed);
+	}
+};
+
+//Default proof number table size in MB, and entries per bucket
+#define DFPN_DEFAULT_MB 64
+#define DFPN_BUCKET 4
+//proof or disproof number of a proven or disproven node
+#define DFPN_INF 0x3fffffffu
+//a search first tries to solve boards with at most this many empty tiles,
+//using this share of the move's time
+#define DFPN_MAX_EMPTY 36
+#define DFPN_TIME_SHARE 0.25
+
+//Results of the proof number solver, for the player to move
+#define SOLVE_UNKNOWN 0
+#define SOLVE_WIN 1
+#define SOLVE_DRAW 2
+#define SOLVE_LOSS 3
+
+const char *solve_name(int result) {
+	static const char *names[] = {"unknown", "win", "draw", "loss"};
+	return names[result];
+}
+
+//One proof number table slot: the proof and disproof numbers of a position
+//(see DfpnSearch) and the # of nodes searched below it, 0 for an empty slot
+struct DfpnEntry {
+	uint64_t key;
+	uint32_t phi;
+	uint32_t delta;
+	uint32_t work;
+};
+
+/* Fixed size table of the proof number solver, buckets of DFPN_BUCKET
+ * entries.  A new position takes the slot with the least work below it, so
+ * the numbers of big subtrees stay.  The memory is only taken by the first solve, engines on
+ * boards too big to solve never use it.  Entries stay valid between moves,
+ * once the game is solved the rest of it is played from the table.
+ */
+struct DfpnTable {
+	std::vector<DfpnEntry> entries;
+	uint64_t bucket_mask;
+	unsigned int size_mb;
+
+	DfpnTable(unsigned int mb=DFPN_DEFAULT_MB): bucket_mask(0), size_mb(mb) {}
+
+	//size_mb of 0 turns the solver off
+	bool enabled() const {
+		return size_mb > 0;
+	}
+
+	void allocate() {
+		if (!entries.empty() || size_mb == 0)
+			return;
+		uint64_t bytes = (uint64_t)size_mb << 20;
+		uint64_t buckets = 1;
+		while (buckets * 2 * DFPN_BUCKET * sizeof(DfpnEntry) <= bytes)
+			buckets *= 2;
+		entries.assign(buckets * DFPN_BUCKET, DfpnEntry());
+		bucket_mask = buckets - 1;
+	}
+
+	bool probe(uint64_t key, uint32_t &phi, uint32_t &delta) const {
+		const DfpnEntry *bucket = &entries[(key & bucket_mask) * DFPN_BUCKET];
+		for (int i = 0; i < DFPN_BUCKET; i++) {
+			if (bucket[i].work && bucket[i].key == key) {
+				phi = bucket[i].phi;
+				delta = bucket[i].delta;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void store(uint64_t key, uint32_t phi, uint32_t delta, uint32_t work) {
+		DfpnEntry *bucket = &entries[(key & bucket_mask) * DFPN_BUCKET];
+		DfpnEntry *slot = &bucket[0];
+		for (int i = 0; i < DFPN_BUCKET && slot->key != key; i++) {
+			if (bucket[i].key == key || bucket[i].work < slot->work)
+				slot = &bucket[i];
+		}
+		slot->key = key;
+		slot->phi = phi;
+		slot->delta = delta;
+		slot->work = std::max(work, 1u);
+	}
+};
+
+//Deepest ply killer moves are kept for
+#define MAX_PLY 64
+//half width of the first aspiration window around the last iteration's
+//score, and how much it grows each time the score falls outside it
+#define ASPIRATION_WINDOW 2048
+#define ASPIRATION_GROWTH 4
+//late move reductions: the first LMR_FULL_MOVES moves of a node are always
+//searched to full depth, later ones LMR_REDUCTION plies less at nodes of at
+//least LMR_MIN_DEPTH
+#define LMR_FULL_MOVES 3
+#define LMR_REDUCTION 2
+#define LMR_MIN_DEPTH 3
+
+//Nodes and time of one completed iteration of the main thread
+struct IterationStats {
+	unsigned int depth;
+	unsigned long long nodes;
+	double time;
+
+	IterationStats(unsigned int depth, unsigned long long nodes, double time):
+		depth(depth), nodes(nodes), time(time) {}
+};
+
+/* Statistics of one itr_deep_minimax or mcts_search call, printed after a move with --stats
+ * and written as one JSON line per move with --stats-json
+ */
+struct SearchStats {
+	//nodes of every thread, and how many of them were scored as leaves
+	unsigned long long nodes;
+	unsigned long long evaluations;
+	//# of cutoffs, and how many of those came from the first move searched
+	unsigned long long cutoffs;
+	unsigned long long first_move_cutoffs;
+	//transposition table lookups, the ones that found the position and the
+	//ones whose score ended the node
+	unsigned long long tt_probes;
+	unsigned long long tt_hits;
+	unsigned long long tt_cutoffs;
+	//null window searches of principal variation search, and how many of
+	//them had to be searched again with the full window
+	unsigned long long null_windows;
+	unsigned long long researches;
+	//iterations whose score fell outside the aspiration window
+	unsigned long long aspiration_fails;
+	//late moves searched shallower, and how many of them then beat alpha
+	//and were searched again to full depth
+	unsigned long long reductions;
+	unsigned long long reduction_researches;
+	//nodes whose moves were cut down to wins or blocks of a threat
+	unsigned long long forced_nodes;
+	//Monte Carlo tree search: playouts of every thread, and tree nodes
+	//after the search and kept from the search of the move before
+	unsigned long long playouts;
+	unsigned long long tree_nodes;
+	unsigned long long reused_nodes;
+	//result of the proof number solver run before the search (SOLVE_UNKNOWN
+	//when it was not run or ran out of time) and its nodes
+	int solved;
+	unsigned long long solver_nodes;
+	//deepest completed iteration, or deepest tree node of a Monte Carlo
+	//tree search
+	unsigned int depth_reached;
+	//seconds the whole move took
+	double time;
+	//true if the move came from a threat space search win
+	bool threat_win;
+	//true if the move came from the opening book
+	bool book_move;
+	std::vector<IterationStats> iterations;
+
+	SearchStats() {
+		clear();
+	}
+
+	void clear() {
+		nodes = 0;
+		evaluations = 0;
+		cutoffs = 0;
+		first_move_cutoffs = 0;
+		tt_probes = 0;
+		tt_hits = 0;
+		tt_cutoffs = 0;
+		null_windows = 0;
+		researches = 0;
+		aspiration_fails = 0;
+		reductions = 0;
+		reduction_researches = 0;
+		forced_nodes = 0;
+		playouts = 0;
+		tree_nodes = 0;
+		reused_nodes = 0;
+		solved = SOLVE_UNKNOWN;
+		solver_nodes = 0;
+		depth_reached = 0;
+		time = 0;
+		threat_win = false;
+		book_move = false;
+		iterations.clear();
+	}
+
+	//adds the counters of a helper thread
+	void add(const SearchStats &helper) {
+		nodes += helper.nodes;
+		evaluations += helper.evaluations;
+		cutoffs += helper.cutoffs;
+		first_move_cutoffs += helper.first_move_cutoffs;
+		tt_probes += helper.tt_probes;
+		tt_hits += helper.tt_hits;
+		tt_cutoffs += helper.tt_cutoffs;
+		null_windows += helper.null_windows;
+		researches += helper.researches;
+		aspiration_fails += helper.aspiration_fails;
+		reductions += helper.reductions;
+		reduction_researches += helper.reduction_researches;
+		forced_nodes += helper.forced_nodes;
+		playouts += helper.playouts;
+	}
+
+	double nps() const {
+		return (time > 0) ? nodes / time : 0;
+	}
+
+	//nodes per ply from the last two iterations, which are 2 plies apart
+	double ebf() const {
+		size_t count = iterations.size();
+		if (count < 2 || iterations[count-2].nodes == 0)
+			return 0;
+		double ratio = (double)iterations[count-1].nodes / iterations[count-2].nodes;
+		double plies = iterations[count-1].depth - iterations[count-2].depth;
+		return pow(ratio, 1.0 / plies);
+	}
+
+	double tt_hit_rate() const {
+		return tt_probes ? (double)tt_hits / tt_probes : 0;
+	}
+
+	double first_move_rate() const {
+		return cutoffs ? (double)first_move_cutoffs / cutoffs : 0;
+	}
+
+	double research_rate() const {
+		return null_windows ? (double)researches / null_windows : 0;
+	}
+
+	void print(std::ostream &out) const {
+		out << "  depth " << depth_reached << ", " << nodes << " nodes, " << evaluations
+		    << " evaluations, " << time << "s, " << (unsigned long long)nps() << " nodes/s";
+		if (threat_win)
+			out << ", threat space win";
+		if (book_move)
+			out << ", book move";
+		out << "\n  ebf " << ebf() << ", " << cutoffs << " cutoffs ("
+		    << 100 * first_move_rate() << "% first move), table hits "
+		    << 100 * tt_hit_rate() << "% of " << tt_probes << ", " << tt_cutoffs
+		    << " table cutoffs\n  re-searches " << 100 * research_rate() << "% of "
+		    << null_windows << " null windows, " << aspiration_fails << " aspiration fails\n  "
+		    << reductions << " reductions (" << reduction_researches << " searched again), "
+		    << forced_nodes << " forced nodes\n";
+		if (playouts)
+			out << "  " << playouts << " playouts, " << tree_nodes << " tree nodes (" << reused_nodes << " reused)\n";
+		if (solver_nodes)
+			out << "  solver: " << solve_name(solved) << " in " << solver_nodes << " nodes\n";
+		out << "  iterations:";
+		for (size_t i = 0; i < iterations.size(); i++)
+			out << " " << iterations[i].depth << ": " << iterations[i].time << "s";
+		out << std::endl;
+	}
+
+	//one line of JSON for the move_number-th move of the game, player's move
+	void write_json(std::ostream &out, unsigned int move_number, char player, std::pair<int, int> move) const {
+		out << "{\"move\": " << move_number << ", \"player\": \"" << player
+		    << "\", \"row\": " << move.first << ", \"column\": " << move.second
+		    << ", \"depth\": " << depth_reached << ", \"nodes\": " << nodes
+		    << ", \"evaluations\": " << evaluations << ", \"time\": " << time
+		    << ", \"nps\": " << nps() << ", \"ebf\": " << ebf()
+		    << ", \"cutoffs\": " << cutoffs << ", \"first_move_cutoffs\": " << first_move_cutoffs
+		    << ", \"tt_probes\": " << tt_probes << ", \"tt_hits\": " << tt_hits
+		    << ", \"tt_hit_rate\": " << tt_hit_rate() << ", \"tt_cutoffs\": " << tt_cutoffs
+		    << ", \"null_windows\": " << null_windows << ", \"researches\": " << researches
+		    << ", \"research_rate\": " << research_rate() << ", \"aspiration_fails\": " << aspiration_fails
+		    << ", \"reductions\": " << reductions << ", \"reduction_researches\": " << reduction_researches
+		    << ", \"forced_nodes\": " << forced_nodes << ", \"playouts\": " << playouts
+		    << ", \"tree_nodes\": " << tree_nodes << ", \"reused_nodes\": " << reused_nodes
+		    << ", \"solved\": \"" << solve_name(solved) << "\", \"solver_nodes\": " << solver_nodes
+		    << ", \"threat_win\": " << (threat_win ? "true" : "false")
+		    << ", \"book_move\": " << (book_move ? "true" : "false") << ", \"iterations\": [";
+		for (size_t i = 0; i < iterations.size(); i++) {
+			out << (i ? ", " : "") << "{\"depth\": " << iterations[i].depth << ", \"nodes\": "
+			    << iterations[i].nodes << ", \"time\": " << iterations[i].time << "}";
+		}
+		out << "]}" << std::endl;
+	}
+};
+
+struct OpeningBook;
+
+//Settings and running totals for one itr_deep_minimax call
+struct SearchContext {
+	//started by itr_deep_minimax, the hard limit is the time_limit of a move
+	TimeManager time;
+	unsigned int m;
+	//transposition table kept between moves, NULL to search without one
+	TransTable *tt;
+	//deepest iteration to search, 0 for no limit other than time_limit
+	unsigned int max_depth;
+	//depth of the iteration being searched
+	unsigned int root_depth;
+	bool cutoff;
+	SearchStats stats;
+	//false searches moves in plain row/column order
+	bool use_ordering;
+	//look for a forced win with threat space search before alphabeta
+	bool use_tss;
+	//search with the engine compiled for the board size and m, if any
+	bool use_specialized;
+	//principal variation search and aspiration windows, false for plain
+	//full window alpha beta
+	bool use_pvs;
+	//late move reductions, only made in principal variation search
+	bool use_lmr;
+	//answer an opponent's four with only the blocking moves, see forced_moves
+	bool use_threat_filter;
+	//moves are searched on empty tiles within radius of a piece, 1 or 2
+	unsigned int radius;
+	//two moves per ply that last caused a cutoff, as row*MAX_BOARD_LIMIT+column
+	int killers[MAX_PLY][2];
+	//how often each tile caused a cutoff, weighted by depth
+	unsigned int history[MAX_BOARD_LIMIT*MAX_BOARD_LIMIT];
+	//# of search threads, the main thread is thread 0 and the rest are
+	//helpers that fill the shared table
+	unsigned int threads;
+	unsigned int thread_id;
+	//set by the main thread when it is done, ends the helpers' searches
+	std::atomic<bool> *stop;
+	//triangular principal variation table, pv_table[ply] holds the best
+	//line found from the node at ply, up to pv_length[ply]
+	std::pair<int, int> pv_table[MAX_PLY][MAX_PLY];
+	unsigned int pv_length[MAX_PLY];
+	//principal variation of the deepest iteration, starting with the move
+	//itr_deep_minimax returns, and its score for the player to move
+	std::vector<std::pair<int, int> > pv;
+	int score;
+	//when set, the main thread prints the principal variation after each
+	//iteration, as "x,y" Gomocup tiles if gomocup_pv
+	std::ostream *pv_out;
+	bool gomocup_pv;
+	//seed of the random numbers of a Monte Carlo tree search, thread i
+	//draws from its own generator seeded from it
+	uint64_t seed;
+	//book engine_search plays from before searching, NULL for none
+	const OpeningBook *book;
+	//table of the proof number solver tried before searching small boards,
+	//NULL for none
+	DfpnTable *solver;
+
+	SearchContext(double time_l=1, unsigned int match=3, TransTable *table=NULL):
+		time(time_l), m(match), tt(table), max_depth(0), root_depth(0),
+		cutoff(false), use_ordering(true), use_tss(true), use_specialized(true), use_pvs(true),
+		use_lmr(true), use_threat_filter(true), radius(1),
+		threads(1), thread_id(0), stop(NULL), score(0), pv_out(NULL), gomocup_pv(false), seed(0), book(NULL), solver(NULL) {
+		for (int i = 0; i < MAX_PLY; i++) {
+			killers[i][0] = -1;
+			killers[i][1] = -1;
+		}
+		for (int i = 0; i < MAX_BOARD_LIMIT*MAX_BOARD_LIMIT; i++)
+			history[i] = 0;
+		for (int i = 0; i < MAX_PLY; i++)
+			pv_length[i] = 0;
+	}
+
+	//remembers a move that caused a cutoff at ply, searched to depth
+	void add_cutoff(int row, int column, unsigned int ply, unsigned int depth) {
+		int tile = row*MAX_BOARD_LIMIT + column;
+		if (ply < MAX_PLY && killers[ply][0] != tile) {
+			killers[ply][1] = killers[ply][0];
+			killers[ply][0] = tile;
+		}
+		history[tile] += depth*depth;
+	}
+
+	/* Whether the index-th move of a node is searched shallower first: a
+	 * late move (after the table move, killers and first few by history) of
+	 * a node deep enough, that does not answer a threat
+	 */
+	bool reduce(unsigned int index, unsigned int depth, unsigned int ply, std::pair<int, int> move,
+		std::pair<int, int> tt_move, bool forced) const {
+		if (!use_lmr || forced || index < LMR_FULL_MOVES || depth < LMR_MIN_DEPTH || move == tt_move)
+			return false;
+		int tile = move.first*MAX_BOARD_LIMIT + move.second;
+		return ply >= MAX_PLY || (killers[ply][0] != tile && killers[ply][1] != tile);
+	}
+
+	//move is the best at ply so far, its line is move then the child's line
+	void update_pv(unsigned int ply, std::pair<int, int> move) {
+		if (ply + 1 >= MAX_PLY)
+			return;
+		pv_table[ply][ply] = move;
+		unsigned int length = std::max(pv_length[ply+1], ply + 1);
+		for (unsigned int i = ply + 1; i < length; i++)
+			pv_table[ply][i] = pv_table[ply+1][i];
+		pv_length[ply] = length;
+	}
+
+	//keeps the root's line as the search's principal variation
+	void save_pv(int root_score) {
+		pv.assign(pv_table[0], pv_table[0] + pv_length[0]);
+		score = root_score;
+	}
+};
+
+//Order keys of moves, higher keys are searched first.  History counts are
+//kept below ORDER_KILLER
+#define ORDER_TT_MOVE (1 << 30)
+#define ORDER_WIN (1 << 29)
+#define ORDER_BLOCK (1 << 28)
+#define ORDER_KILLER (1 << 27)
+
+/* Sorts the moves of a node: the transposition table move (the best move of
+ * the previous iteration) first, then moves that win, then moves that block
+ * an opponent's win, then the killer moves of this ply, then the rest by
+ * history count.  Moves with the same key keep their row/column order.
+ * check_threats = false skips looking for wins and blocks, when
+ * forced_moves already found there are none
+ */
+template <unsigned int N=0, unsigned int M=0>
+void order_moves(const GameState &node, MoveList &moves, char current_player, unsigned int ply,
+	std::pair<int, int> tt_move, const SearchContext &ctx, bool check_threats=true) {
+	char opp_player = (current_player == 'X') ? 'O' : 'X';
+	//(negated key, index), the index keeps equal keys in their order
+	std::pair<int, int> keyed[MAX_MOVES];
+	for (unsigned int i = 0; i < moves.size(); i++) {
+		int row = moves[i].first;
+		int column = moves[i].second;
+		int tile = row*MAX_BOARD_LIMIT + column;
+		int key;
+		if (moves[i] == tt_move)
+			key = ORDER_TT_MOVE;
+		else if (check_threats && node.wins_at<N, M>(row, column, current_player))
+			key = ORDER_WIN;
+		else if (check_threats && node.wins_at<N, M>(row, column, opp_player))
+			key = ORDER_BLOCK;
+		else if (ply < MAX_PLY && ctx.killers[ply][0] == tile)
+			key = ORDER_KILLER + 1;
+		else if (ply < MAX_PLY && ctx.killers[ply][1] == tile)
+			key = ORDER_KILLER;
+		else
+			key = (ctx.history[tile] < ORDER_KILLER) ? ctx.history[tile] : ORDER_KILLER - 1;
+		//negated so the sort puts higher keys first
+		keyed[i].first = -key;
+		keyed[i].second = i;
+	}
+	std::sort(keyed, keyed + moves.size());
+	std::pair<int, int> sorted[MAX_MOVES];
+	for (unsigned int i = 0; i < moves.size(); i++)
+		sorted[i] = moves[keyed[i].second];
+	std::copy(sorted, sorted + moves.size(), moves.moves);
+}
+
+/* Cuts the moves of a node down to the ones that win on the spot or, when
+ * there are none, to the ones on tiles where the opponent would make m in a
+ * row (the opponent's 'four' or 'straight four').  Any other move loses to
+ * the opponent's next move, so the cut loses nothing.
+ * Postconditions: Returns true if moves was cut down, false if there is no
+ *                 win or threat to answer and moves is unchanged
+ */
+template <unsigned int N=0, unsigned int M=0>
+bool forced_moves(const GameState &node, MoveList &moves, char current_player) {
+	char opp_player = (current_player == 'X') ? 'O' : 'X';
+	//2 for a winning move, 1 for a block, 0 for any other move
+	unsigned char kind[MAX_MOVES];
+	unsigned char most = 0;
+	for (unsigned int i = 0; i < moves.size(); i++) {
+		kind[i] = 0;
+		if (node.wins_at<N, M>(moves[i].first, moves[i].second, current_player))
+			kind[i] = 2;
+		else if (most < 2 && node.wins_at<N, M>(moves[i].first, moves[i].second, opp_player))
+			kind[i] = 1;
+		most = std::max(most, kind[i]);
+	}
+	if (most == 0)
+		return false;
+	unsigned int kept = 0;
+	for (unsigned int i = 0; i < moves.size(); i++) {
+		if (kind[i] == most)
+			moves[kept++] = moves[i];
+	}
+	moves.count = kept;
+	return true;
+}
+
+/* Drops the moves that give a position symmetric to the one an earlier move
+ * gives, which score the same.  Cuts the first moves of a game to a fraction
+ * (after a piece in the middle of the board, 2 of the 8 next to it are left)
+ * Preconditions: board = position the moves are made on, player's turn
+ */
+template <unsigned int N=0, unsigned int M=0>
+void unique_moves(GameState board, MoveList &moves, char player) {
+	uint64_t seen[MAX_MOVES];
+	unsigned int kept = 0;
+	for (unsigned int i = 0; i < moves.size(); i++) {
+		MoveUndo undo = board.make_move<N, M>(moves[i].first, moves[i].second, player, player);
+		unsigned int symmetry;
+		uint64_t key = board.canonical_key(symmetry);
+		board.unmake_move<N, M>(moves[i].first, moves[i].second, undo);
+		if (std::find(seen, seen + kept, key) != seen + kept)
+			continue;
+		seen[kept] = key;
+		moves[kept++] = moves[i];
+	}
+	moves.count = kept;
+}
+
+/* Key of a search node, the board's canonical key plus the scoring
+ * perspective and the kind of node, so the 8 turns and flips of a position
+ * share one table entry.  Moves in the table are kept in the canonical
+ * symmetry, see to_table and from_table
+ * Postconditions: symmetry = the symmetry of the canonical key
+ */
+uint64_t search_key(const GameState &node, char player, bool maxPlayer, unsigned int &symmetry) {
+	uint64_t key = node.canonical_key(symmetry);
+	if (player == 'O')
+		key ^= zobrist_o_persp;
+	if (maxPlayer)
+		key ^= zobrist_max_node;
+	return key;
+}
+
+//move on an n x n board turned into symmetry for the table, (-1, -1) for
+//no move is kept as it is
+std::pair<int, int> to_table(std::pair<int, int> move, unsigned int n, unsigned int symmetry) {
+	if (move.first < 0)
+		return move;
+	return symmetry_tile(symmetry, n, move.first, move.second);
+}
+
+//move of a table entry turned back from symmetry onto the board
+std::pair<int, int> from_table(const TTData &data, unsigned int n, unsigned int symmetry) {
+	if (data.row < 0)
+		return std::pair<int, int>(-1, -1);
+	return inverse_symmetry_tile(symmetry, n, data.row, data.column);
+}
+
+/* Alpha beta search over a single board in negamax form: every node scores
+ * itself from the side to move, so a child's score is negated and max and
+ * min nodes share one loop.  Each move is made on root before searching it
+ * and unmade after, so no board copies are made per node.  maxPlayer is
+ * still passed down since the board is scored from player's perspective,
+ * the root player, and the leaves negate that score at min nodes.
+ * Preconditions: root = GameState object representing the game board, it is
+ *                left as it was when the function returns, ply =
+ *                ctx.root_depth - depth
+ * Postconditions: Returns the score for the side to move, within alpha and
+ *                 beta (fail hard); ctx.pv_table[ply] holds the moves from
+ *                 this node that lead to it
+ */
+template <unsigned int N, unsigned int M>
+int alphabeta(GameState &root, unsigned int depth, int alpha, int beta,
+	char player, bool maxPlayer, SearchContext &ctx) {
+	unsigned int ply = ctx.root_depth - depth;
+	if (ply < MAX_PLY)
+		ctx.pv_length[ply] = ply;
+
+	ctx.stats.nodes++;
+	//the clock is only read every TIME_CHECK_NODES nodes
+	if ((ctx.stats.nodes & (TIME_CHECK_NODES - 1)) == 0) {
+		if (ctx.time.hard_expired() || (ctx.stop && ctx.stop->load(std::memory_order_relaxed)))
+			ctx.cutoff = true;
+	}
+	if (ctx.cutoff)
+		return alpha;
+
+	//if terminal node, or depth at zero
+	if (depth == 0 || root.game_end || root.tiles_left == 0) {
+		ctx.stats.evaluations++;
+		int hscore = root.hscore;
+		//Given the choice between winning moves, we wish the pick the winning
+		//sequence that is closer to starting node in the alphabeta search
+		//higher priority is given to winning quicker. likewise, if a node is
+		//a losing one, the quicker we lose, the worst off we are
+		if (hscore == SCORE_WIN)
+			hscore += depth;
+		if (hscore == SCORE_LOSE)
+			hscore -= depth;
+		return maxPlayer ? hscore : -hscore;
+	}
 
-	//starts alphabeta algorithm with player's turn
-	//alphabeta generates every move starting with player
-	//clock_gettime(CLOCK_REALTIME, &prog_start);
-	clock_gettime(CLOCK_REALTIME, &start);
-	while (!cutoff) {
-		best_move = alphabeta(root, depth, alpha, beta, player, true, start, time_limit, cutoff, m);
-		if (!cutoff) {
+	//used to flip the players for generating new moves
+	char opponent = (player == 'X') ? 'O' : 'X';
+	char current_player = maxPlayer ? player : opponent;
+	//a stored score from a search at least as deep ends the node early, except
+	//at the root where the move itself is needed
+	uint64_t tt_key = 0;
+	unsigned int symmetry = 0;
+	std::pair<int, int> tt_move(-1, -1);
+	if (ctx.tt) {
+		TTData tt_data;
+		tt_key = search_key(root, player, maxPlayer, symmetry);
+		bool tt_hit = ctx.tt->probe(tt_key, tt_data);
+		ctx.stats.tt_probes++;
+		if (tt_hit) {
+			ctx.stats.tt_hits++;
+			tt_move = from_table(tt_data, N ? N : root.n, symmetry);
+		}
+		if (tt_hit && depth < ctx.root_depth && tt_data.depth >= depth) {
+			if (tt_data.bound == BOUND_EXACT
+				|| (tt_data.bound == BOUND_LOWER && tt_data.score >= beta)
+				|| (tt_data.bound == BOUND_UPPER && tt_data.score <= alpha)) {
+				ctx.stats.tt_cutoffs++;
+				return tt_data.score;
+			}
+		}
+	}
+	int alpha_start = alpha;
+	//best child seen, stored in the table even if it did not change alpha
+	int best_score = ALPHA_INF - 1;
+	std::pair<int, int> best_child(-1, -1);
+
+	MoveList moves;
+	gen_all_moves<N>(root, moves, ctx.radius);
+	bool forced = ctx.use_threat_filter && forced_moves<N, M>(root, moves, current_player);
+	if (forced)
+		ctx.stats.forced_nodes++;
+	if (ctx.use_ordering)
+		order_moves<N, M>(root, moves, current_player, ply, tt_move, ctx, forced || !ctx.use_threat_filter);
+
+	for (MoveList::iterator itr = moves.begin(); itr != moves.end(); itr++) {
+		int score;
+		MoveUndo undo = root.make_move<N, M>(itr->first, itr->second, current_player, player);
+		if (itr == moves.begin() || !ctx.use_pvs)
+			score = -alphabeta<N, M>(root, depth-1, -beta, -alpha, player, !maxPlayer, ctx);
+		else {
+			//the moves after the first are only shown to be no better than
+			//alpha, and searched again in full when one is.  Late quiet
+			//moves are first searched LMR_REDUCTION plies shallower
+			ctx.stats.null_windows++;
+			if (ctx.reduce(itr - moves.begin(), depth, ply, *itr, tt_move, forced)) {
+				ctx.stats.reductions++;
+				score = -alphabeta<N, M>(root, depth-1-LMR_REDUCTION, -alpha-1, -alpha, player, !maxPlayer, ctx);
+				if (!ctx.cutoff && score > alpha) {
+					ctx.stats.reduction_researches++;
+					score = -alphabeta<N, M>(root, depth-1, -alpha-1, -alpha, player, !maxPlayer, ctx);
+				}
+			}
+			else
+				score = -alphabeta<N, M>(root, depth-1, -alpha-1, -alpha, player, !maxPlayer, ctx);
+			if (!ctx.cutoff && score > alpha && score < beta) {
+				ctx.stats.researches++;
+				score = -alphabeta<N, M>(root, depth-1, -beta, -alpha, player, !maxPlayer, ctx);
+			}
+		}
+		root.unmake_move<N, M>(itr->first, itr->second, undo);
+		if (ctx.cutoff)
+			return alpha;
+		if (score > best_score) {
+			best_score = score;
+			best_child = *itr;
+		}
+		if (score > alpha) {
+			alpha = score;
+			ctx.update_pv(ply, *itr);
+		}
+		if (alpha >= beta) {
+			ctx.stats.cutoffs++;
+			if (itr == moves.begin())
+				ctx.stats.first_move_cutoffs++;
+			ctx.add_cutoff(itr->first, itr->second, ply, depth);
+			break;
+		}
+	}
+	if (ctx.tt) {
+		int bound = BOUND_EXACT;
+		if (alpha <= alpha_start)
+			bound = BOUND_UPPER;
+		else if (alpha >= beta)
+			bound = BOUND_LOWER;
+		std::pair<int, int> stored = to_table(best_child, N ? N : root.n, symmetry);
+		ctx.tt->store(tt_key, alpha, depth, bound, stored.first, stored.second);
+	}
+	return alpha;
+}
+
+//A move of the root and its score in the last iteration that searched it
+struct RootMove {
+	std::pair<int, int> move;
+	int score;
+};
+
+bool root_move_greater(const RootMove &a, const RootMove &b) {
+	return a.score > b.score;
+}
+
+//root moves in the order of the first iteration, the table move of an
+//earlier search of the position first
+template <unsigned int N, unsigned int M>
+std::vector<RootMove> root_moves(const GameState &root, char player, const SearchContext &ctx) {
+	MoveList moves;
+	gen_all_moves<N>(root, moves, ctx.radius);
+	std::pair<int, int> tt_move(-1, -1);
+	TTData tt_data;
+	unsigned int symmetry;
+	if (ctx.tt && ctx.tt->probe(search_key(root, player, true, symmetry), tt_data))
+		tt_move = from_table(tt_data, root.n, symmetry);
+	bool forced = ctx.use_threat_filter && forced_moves<N, M>(root, moves, player);
+	unique_moves<N, M>(root, moves, player);
+	//the table move may be one of the symmetric moves dropped
+	if (tt_move.first >= 0 && std::find(moves.moves, moves.moves + moves.size(), tt_move) == moves.moves + moves.size())
+		tt_move = std::pair<int, int>(-1, -1);
+	if (ctx.use_ordering)
+		order_moves<N, M>(root, moves, player, 0, tt_move, ctx, forced || !ctx.use_threat_filter);
+	std::vector<RootMove> out(moves.size());
+	for (size_t i = 0; i < moves.size(); i++) {
+		out[i].move = moves[i];
+		out[i].score = ALPHA_INF;
+	}
+	return out;
+}
+
+/* Searches the root moves in order to depth within the window (low, high),
+ * keeping the score of each one that is fully searched
+ * Preconditions: root = game board, moves = root moves of root, player's
+ *                move
+ * Postconditions: Returns the # of moves fully searched before the search
+ *                 was cut off (all of them if it was not), best = the best
+ *                 of those and its score, ctx.pv_table[0] its principal
+ *                 variation.  best's score is low with no move when every
+ *                 move failed low, and at least high when a move failed
+ *                 high, which ends the search
+ */
+template <unsigned int N, unsigned int M>
+unsigned int search_root(GameState &root, unsigned int depth, char player, std::vector<RootMove> &moves,
+	SearchContext &ctx, std::pair<int, std::pair<int, int> > &best, int low=ALPHA_INF, int high=BETA_INF) {
+	int alpha = low;
+	std::pair<int, int> best_root(-1, -1);
+	ctx.pv_length[0] = 0;
+	unsigned int searched = 0;
+	for (size_t i = 0; i < moves.size(); i++) {
+		int row = moves[i].move.first;
+		int column = moves[i].move.second;
+		MoveUndo undo = root.make_move<N, M>(row, column, player, player);
+		int score;
+		if (i == 0 || !ctx.use_pvs)
+			score = -alphabeta<N, M>(root, depth-1, -high, -alpha, player, false, ctx);
+		else {
+			ctx.stats.null_windows++;
+			score = -alphabeta<N, M>(root, depth-1, -alpha-1, -alpha, player, false, ctx);
+			if (!ctx.cutoff && score > alpha && score < high) {
+				ctx.stats.researches++;
+				score = -alphabeta<N, M>(root, depth-1, -high, -alpha, player, false, ctx);
+			}
+		}
+		root.unmake_move<N, M>(row, column, undo);
+		if (ctx.cutoff)
+			break;
+		searched++;
+		moves[i].score = score;
+		if (score > alpha) {
+			alpha = score;
+			best_root = moves[i].move;
+			ctx.update_pv(0, moves[i].move);
+		}
+		if (alpha >= high)
+			break;
+	}
+	best.first = alpha;
+	best.second = best_root;
+	return searched;
+}
+
+/* The triangular table's line stops at a node that was ended by a table hit,
+ * so the line is carried on with the table's moves up to depth moves
+ * Preconditions: root = board the line starts from, player = root player
+ */
+void extend_pv(GameState root, char player, SearchContext &ctx, unsigned int depth) {
+	if (!ctx.tt)
+		return;
+	char opponent = (player == 'X') ? 'O' : 'X';
+	for (size_t i = 0; i < ctx.pv.size(); i++)
+		root.set(ctx.pv[i].first, ctx.pv[i].second, (i % 2 == 0) ? player : opponent);
+	root.evaluate(player);
+	while (ctx.pv.size() < depth && !root.game_end) {
+		bool maxPlayer = (ctx.pv.size() % 2 == 0);
+		TTData data;
+		unsigned int symmetry;
+		if (!ctx.tt->probe(search_key(root, player, maxPlayer, symmetry), data))
+			break;
+		std::pair<int, int> move = from_table(data, root.n, symmetry);
+		if (move.first < 0 || move.first >= (int)root.n || move.second >= (int)root.n
+			|| root.at(move.first, move.second) != '.')
+			break;
+		root.set(move.first, move.second, maxPlayer ? player : opponent);
+		root.evaluate(player);
+		ctx.pv.push_back(move);
+	}
+}
+
+/* Prints the principal variation of a completed iteration as row,column
+ * tiles, or for the Gomocup protocol as a MESSAGE of x,y tiles
+ */
+void print_pv(std::ostream &out, const SearchContext &ctx, unsigned int depth, bool gomocup) {
+	out << (gomocup ? "MESSAGE" : " ") << " depth " << depth << " score " << ctx.score << " pv";
+	for (size_t i = 0; i < ctx.pv.size(); i++) {
+		if (gomocup)
+			out << " " << ctx.pv[i].second << "," << ctx.pv[i].first;
+		else
+			out << " " << ctx.pv[i].first << "," << ctx.pv[i].second;
+	}
+	out << std::endl;
+}
+
+/* Searches depth first_depth, first_depth+2, ... until the time runs out,
+ * ctx.max_depth is reached or the search is stopped.  The main thread does
+ * not start an iteration it is not predicted to finish.  Each iteration
+ * searches the root moves best first by the scores of the one before, so
+ * when an iteration is cut off, a move that beat the last iteration's best
+ * move in the part that was searched is played instead
+ * Preconditions: root = game board, player = player to move, ctx.time was
+ *                reset at the start of the search
+ * Postconditions: Returns the best move of the deepest completed iteration,
+ *                 ctx.stats.depth_reached is that iteration's depth
+ */
+template <unsigned int N, unsigned int M>
+std::pair<int, int> deepen(GameState &root, char player, SearchContext &ctx, unsigned int first_depth) {
+	std::pair<int, int> r_move(-1, -1);
+	std::vector<RootMove> moves = root_moves<N, M>(root, player, ctx);
+	unsigned int depth = first_depth;
+	std::pair<int, std::pair<int, int> > best_move;
+	//times of the last two completed iterations
+	double prev_time = 0;
+	double last_time = 0;
+	uint64_t iteration_nodes = ctx.stats.nodes;
+	int last_score = 0;
+	//a forced line ends an iteration quickly however deep it is, so the
+	//depth is capped where the ply tables end
+	while (!ctx.cutoff && (ctx.max_depth == 0 || depth <= ctx.max_depth) && depth < MAX_PLY) {
+		ctx.root_depth = depth;
+		double iteration_start = ctx.time.elapsed();
+		//the window starts around the last iteration's score, and is widened
+		//on the side the score fell out of until the score lands inside it
+		int low = ALPHA_INF;
+		int high = BETA_INF;
+		int delta = ASPIRATION_WINDOW;
+		if (ctx.use_pvs && r_move.first >= 0 && abs(last_score) < SCORE_WIN) {
+			low = last_score - delta;
+			high = last_score + delta;
+		}
+		unsigned int searched = search_root<N, M>(root, depth, player, moves, ctx, best_move, low, high);
+		while (!ctx.cutoff && ((best_move.first <= low && low > ALPHA_INF) || (best_move.first >= high && high < BETA_INF))) {
+			ctx.stats.aspiration_fails++;
+			delta *= ASPIRATION_GROWTH;
+			if (best_move.first <= low)
+				low = (delta >= SCORE_WIN) ? ALPHA_INF : last_score - delta;
+			else
+				high = (delta >= SCORE_WIN) ? BETA_INF : last_score + delta;
+			searched = search_root<N, M>(root, depth, player, moves, ctx, best_move, low, high);
+		}
+		//the first move searched is the last iteration's best, so the best of
+		//a cut off iteration is that move or one that beat it at this depth
+		if (ctx.cutoff && searched > 0 && best_move.second.first >= 0) {
+			r_move = best_move.second;
+			ctx.save_pv(best_move.first);
+		}
+		if (!ctx.cutoff) {
 			r_move = best_move.second;
-			//
-			//std::cout << "BEST MOVE:" << r_move.first <<", " <<r_move.second <<" SCORE: " << best_move.first << std::endl;
-			//
+			ctx.save_pv(best_move.first);
+			last_score = best_move.first;
+			ctx.stats.depth_reached = depth;
+			if (ctx.use_ordering)
+				std::stable_sort(moves.begin(), moves.end(), root_move_greater);
+			prev_time = last_time;
+			last_time = ctx.time.elapsed() - iteration_start;
+			if (ctx.thread_id == 0) {
+				ctx.stats.iterations.push_back(IterationStats(depth, ctx.stats.nodes - iteration_nodes, last_time));
+				extend_pv(root, player, ctx, depth);
+				if (ctx.pv_out)
+					print_pv(*ctx.pv_out, ctx, depth, ctx.gomocup_pv);
+			}
+			iteration_nodes = ctx.stats.nodes;
+			//every line already runs to the end of the game
+			if (depth >= root.tiles_left)
+				break;
 			depth+=2;
+			if (ctx.thread_id == 0 && !ctx.time.next_iteration(prev_time, last_time))
+				break;
+		}
+	}
+	return r_move;
+}
+
+/* Runs deepen with the engine compiled for the board's size and m when
+ * there is one, 15x15 and 19x19 with m = 5, and the generic one otherwise
+ */
+std::pair<int, int> deepen_dispatch(GameState &root, char player, SearchContext &ctx, unsigned int first_depth) {
+	if (ctx.use_specialized && root.n == 15 && root.m == 5)
+		return deepen<15, 5>(root, player, ctx, first_depth);
+	if (ctx.use_specialized && root.n == 19 && root.m == 5)
+		return deepen<19, 5>(root, player, ctx, first_depth);
+	return deepen<0, 0>(root, player, ctx, first_depth);
+}
+
+//body of a Lazy SMP helper thread, its result is only the table entries
+void helper_search(GameState root, char player, SearchContext *ctx) {
+	//every other helper starts one iteration ahead, so the threads are
+	//spread over two depths instead of all searching the same tree
+	unsigned int first_depth = (ctx->thread_id % 2) ? 3 : 1;
+	if (ctx->max_depth != 0 && first_depth > ctx->max_depth)
+		first_depth = 1;
+	deepen_dispatch(root, player, *ctx, first_depth);
+}
+
+/* A forced win made of threats is often deeper than a search gets, and takes
+ * a small part of the time to find, so with ctx.use_tss a VCF and then a VCT
+ * search are run first
+ * Postconditions: Returns true with move = the first move of a win that was
+ *                 found, ctx.pv = its line and ctx.stats.threat_win set
+ */
+bool threat_move(const GameState &root, char player, SearchContext &ctx, std::pair<int, int> &move) {
+	if (!ctx.use_tss)
+		return false;
+	ThreatResult threat = threat_space_search(root, player, false, TSS_VCF_DEPTH, 0, ctx.time.hard_limit * 0.05, ctx.stop);
+	if (!threat.found)
+		threat = threat_space_search(root, player, true, TSS_VCT_DEPTH, 0, ctx.time.hard_limit * 0.1, ctx.stop);
+	if (!threat.found)
+		return false;
+	ctx.pv = threat.sequence;
+	ctx.score = SCORE_WIN;
+	ctx.stats.threat_win = true;
+	ctx.stats.time = ctx.time.elapsed();
+	move = threat.move;
+	return true;
+}
+
+/* Depth first proof number search (df-pn, Nagai) of whether attacker wins.
+ * Every empty tile is a move and there is no depth limit, so what it proves
+ * is exact.  Each node has a proof number phi and a disproof number delta
+ * for the player to move: about how many more leaves have to be solved to
+ * show the player to move gets what it plays for (a win for the attacker, a
+ * draw or better for the defender), and to show it does not.  phi is the
+ * least delta of the children, 0 when proven, and delta the largest phi of
+ * the children plus 1 for each other child not proven yet (weak proof
+ * numbers: the sum of the children's phi counts a position reached by
+ * several move orders again and again), DFPN_INF when disproven.  mid()
+ * searches below a node until its numbers reach the thresholds it was
+ * given, always going into the child with the least delta, the one that
+ * looks cheapest to prove, with the memory of a depth first search plus
+ * the table.
+ */
+struct DfpnSearch {
+	DfpnTable *table;
+	char attacker;
+	unsigned long long node_budget;
+	TimeManager timer;
+	//set by another thread to end the search early, NULL for none
+	const std::atomic<bool> *stop;
+	unsigned long long nodes;
+	bool out_of_budget;
+
+	//the solver only needs the bit planes and the symmetry keys, so pieces
+	//are put down and taken back without the line rescoring of set()
+	static void flip(GameState &board, int row, int column, char player) {
+		if (player == 'X')
+			board.x_rows[row] ^= 1u << column;
+		else
+			board.o_rows[row] ^= 1u << column;
+		board.toggle_symmetry_keys(row, column, player);
+	}
+
+	//the canonical key with who moves and who attacks, a board can be a
+	//win for one attacker and a draw for the other
+	uint64_t key(const GameState &board, char to_move) const {
+		unsigned int symmetry;
+		return board.canonical_key(symmetry) ^ ((to_move == 'X') ? 0x9E3779B97F4A7C15ULL : 0)
+			^ ((attacker == 'X') ? 0xD1B54A32D192ED03ULL : 0);
+	}
+
+	//numbers of a position, 1 and 1 for one not searched yet
+	void lookup(uint64_t position, uint32_t &phi, uint32_t &delta) const {
+		if (!table->probe(position, phi, delta)) {
+			phi = 1;
+			delta = 1;
+		}
+	}
+
+	bool budget_left() {
+		if (out_of_budget)
+			return false;
+		if (node_budget && nodes >= node_budget)
+			out_of_budget = true;
+		else if ((nodes & 255) == 0 && (timer.hard_expired() || (stop && stop->load(std::memory_order_relaxed))))
+			out_of_budget = true;
+		return !out_of_budget;
+	}
+
+	//whether player has m tiles in a row (in any direction) with none of
+	//the opponent's pieces on them, without one player can never win
+	static bool open_line(const GameState &board, char player) {
+		const uint32_t *opp = (player == 'X') ? board.o_rows : board.x_rows;
+		uint32_t all = (1u << board.n) - 1;
+		uint32_t free_rows[MAX_BOARD_LIMIT];
+		for (unsigned int r = 0; r < board.n; r++)
+			free_rows[r] = ~opp[r] & all;
+		//a row window starts at each bit still set after m-1 shifts
+		for (unsigned int r = 0; r < board.n; r++) {
+			uint32_t window = free_rows[r];
+			for (unsigned int k = 1; k < board.m; k++)
+				window &= free_rows[r] >> k;
+			if (window)
+				return true;
+		}
+		//the column and diagonal windows starting on row r
+		for (unsigned int r = 0; r + board.m <= board.n; r++) {
+			uint32_t down = all, right = all, left = all;
+			for (unsigned int k = 0; k < board.m; k++) {
+				down &= free_rows[r+k];
+				right &= free_rows[r+k] >> k;
+				left &= free_rows[r+k] << k;
+			}
+			if (down || right || (left & all))
+				return true;
+		}
+		return false;
+	}
+
+	/* Decides a node without searching it when it can: to_move wins on the
+	 * spot, the opponent has two winning tiles, the attacker has no open
+	 * line left or the board is full (both draws).  Otherwise gives its
+	 * moves: the block when the opponent has one winning tile, else every
+	 * empty tile from the middle out, the ones on the most lines first
+	 * Postconditions: Returns true with phi and delta set if decided
+	 */
+	bool expand(const GameState &board, char to_move, MoveList &moves, uint32_t &phi, uint32_t &delta) const {
+		char opponent = (to_move == 'X') ? 'O' : 'X';
+		unsigned int threats = 0;
+		std::pair<int, int> block;
+		moves.count = 0;
+		uint32_t all = (1u << board.n) - 1;
+		for (unsigned int r = 0; r < board.n; r++) {
+			uint32_t bits = ~(board.x_rows[r] | board.o_rows[r]) & all;
+			while (bits) {
+				int c = __builtin_ctz(bits);
+				bits &= bits - 1;
+				if (board.wins_at(r, c, to_move)) {
+					phi = 0;
+					delta = DFPN_INF;
+					return true;
+				}
+				if (board.wins_at(r, c, opponent)) {
+					threats++;
+					block = std::pair<int, int>(r, c);
+				}
+				moves.push_back(std::pair<int, int>(r, c));
+			}
+		}
+		//a draw is what the defender plays for
+		bool draw = moves.size() == 0 || !open_line(board, attacker);
+		bool lost = threats >= 2 || (draw && to_move == attacker);
+		if (lost || draw) {
+			phi = lost ? DFPN_INF : 0;
+			delta = lost ? 0 : DFPN_INF;
+			return true;
+		}
+		if (threats == 1) {
+			moves.count = 0;
+			moves.push_back(block);
+		}
+		else {
+			int centre = board.n - 1;
+			std::stable_sort(moves.moves, moves.moves + moves.size(),
+				[centre](const std::pair<int, int> &a, const std::pair<int, int> &b) {
+					return std::max(abs(2*a.first - centre), abs(2*a.second - centre))
+						< std::max(abs(2*b.first - centre), abs(2*b.second - centre));
+				});
+		}
+		return false;
+	}
+
+	void mid(GameState &board, char to_move, uint32_t th_phi, uint32_t th_delta) {
+		nodes++;
+		unsigned long long first_node = nodes;
+		uint64_t node_key = key(board, to_move);
+		char opponent = (to_move == 'X') ? 'O' : 'X';
+		MoveList moves;
+		uint32_t phi, delta;
+		if (expand(board, to_move, moves, phi, delta)) {
+			table->store(node_key, phi, delta, 1);
+			return;
+		}
+		//moves to symmetric positions give the same child key, one of them
+		//is kept
+		uint64_t child_keys[MAX_MOVES];
+		unsigned int kept = 0;
+		for (unsigned int i = 0; i < moves.size(); i++) {
+			board.toggle_symmetry_keys(moves[i].first, moves[i].second, to_move);
+			uint64_t child = key(board, opponent);
+			board.toggle_symmetry_keys(moves[i].first, moves[i].second, to_move);
+			if (std::find(child_keys, child_keys + kept, child) != child_keys + kept)
+				continue;
+			child_keys[kept] = child;
+			moves[kept++] = moves[i];
+		}
+		moves.count = kept;
+		while (true) {
+			//the child with the least delta, the next least delta, and the
+			//largest phi and # of children not proven for delta
+			unsigned int best = 0;
+			uint32_t best_phi = 0;
+			uint32_t best_delta = DFPN_INF;
+			uint32_t second_delta = DFPN_INF;
+			uint32_t most_phi = 0;
+			unsigned int open_children = 0;
+			bool disproven_child = false;
+			for (unsigned int i = 0; i < moves.size(); i++) {
+				uint32_t child_phi, child_delta;
+				lookup(child_keys[i], child_phi, child_delta);
+				if (child_delta < best_delta) {
+					second_delta = best_delta;
+					best = i;
+					best_phi = child_phi;
+					best_delta = child_delta;
+				}
+				else if (child_delta < second_delta)
+					second_delta = child_delta;
+				if (child_phi == DFPN_INF)
+					disproven_child = true;
+				most_phi = std::max(most_phi, child_phi);
+				open_children += (child_phi != 0);
+			}
+			phi = best_delta;
+			delta = 0;
+			if (disproven_child)
+				delta = DFPN_INF;
+			else if (open_children)
+				delta = std::min<uint32_t>(most_phi + open_children - 1, DFPN_INF - 1);
+			if (phi >= th_phi || delta >= th_delta || !budget_left())
+				break;
+			uint64_t child_th_phi = (uint64_t)th_delta - delta + best_phi;
+			uint32_t child_th_delta = std::min<uint64_t>(th_phi, (uint64_t)second_delta + 1);
+			flip(board, moves[best].first, moves[best].second, to_move);
+			mid(board, opponent, (uint32_t)std::min<uint64_t>(child_th_phi, DFPN_INF), std::min(child_th_delta, DFPN_INF));
+			flip(board, moves[best].first, moves[best].second, to_move);
+		}
+		table->store(node_key, phi, delta, (uint32_t)std::min<unsigned long long>(nodes - first_node + 1, 0xffffffffu));
+	}
+
+	//a move of to_move that keeps a proven node proven, (-1, -1) if the
+	//node is not proven or the table lost the child that proved it
+	std::pair<int, int> proven_move(GameState &board, char to_move) {
+		char opponent = (to_move == 'X') ? 'O' : 'X';
+		MoveList moves;
+		uint32_t phi, delta;
+		if (expand(board, to_move, moves, phi, delta)) {
+			//proven without moves: a win on the spot, or a draw because the
+			//attacker has no open line left, kept by any move
+			std::pair<int, int> any(-1, -1);
+			for (unsigned int r = 0; r < board.n; r++) {
+				for (unsigned int c = 0; c < board.n; c++) {
+					if (board.at(r, c) != '.')
+						continue;
+					if (board.wins_at(r, c, to_move))
+						return std::pair<int, int>(r, c);
+					if (any.first < 0)
+						any = std::pair<int, int>(r, c);
+				}
+			}
+			return (phi == 0) ? any : std::pair<int, int>(-1, -1);
+		}
+		for (unsigned int i = 0; i < moves.size(); i++) {
+			flip(board, moves[i].first, moves[i].second, to_move);
+			lookup(key(board, opponent), phi, delta);
+			flip(board, moves[i].first, moves[i].second, to_move);
+			if (delta == 0)
+				return moves[i];
+		}
+		return std::pair<int, int>(-1, -1);
+	}
+};
+
+//Result of a proof number solve
+struct SolveResult {
+	//SOLVE_WIN, SOLVE_DRAW or SOLVE_LOSS for the player to move, or
+	//SOLVE_UNKNOWN when the budget ran out first
+	int result;
+	//a move that keeps a win or draw, (-1, -1) otherwise
+	std::pair<int, int> move;
+	unsigned long long nodes;
+};
+
+/* Solves root for player with two df-pn searches: whether player wins, and
+ * if not, whether the opponent does.  A node_budget or time_budget of 0 is
+ * no limit on it
+ * Preconditions: table = solver table, kept between calls
+ */
+SolveResult dfpn_solve(const GameState &root, char player, DfpnTable &table, unsigned long long node_budget,
+                       double time_budget, const std::atomic<bool> *stop=NULL) {
+	SolveResult out;
+	out.result = SOLVE_UNKNOWN;
+	out.move = std::pair<int, int>(-1, -1);
+	out.nodes = 0;
+	if (root.game_end || root.tiles_left == 0 || !table.enabled())
+		return out;
+	table.allocate();
+	GameState board = root;
+	DfpnSearch search;
+	search.table = &table;
+	search.node_budget = node_budget;
+	search.timer = TimeManager(time_budget > 0 ? time_budget : 1e9);
+	search.stop = stop;
+	search.nodes = 0;
+	search.out_of_budget = false;
+	char opponent = (player == 'X') ? 'O' : 'X';
+	for (int pass = 0; pass < 2 && out.result == SOLVE_UNKNOWN && !search.out_of_budget; pass++) {
+		search.attacker = pass ? opponent : player;
+		search.mid(board, player, DFPN_INF, DFPN_INF);
+		uint32_t phi, delta;
+		search.lookup(search.key(board, player), phi, delta);
+		//player proves a win on the first pass, a draw on the second
+		if (phi == 0) {
+			out.move = search.proven_move(board, player);
+			if (out.move.first >= 0)
+				out.result = pass ? SOLVE_DRAW : SOLVE_WIN;
+			break;
+		}
+		if (delta == 0 && pass == 1)
+			out.result = SOLVE_LOSS;
+	}
+	out.nodes = search.nodes;
+	return out;
+}
+
+/* Small boards, and the end of games on them, can be solved outright, so with
+ * ctx.solver a proof number solve is tried first on boards with at most
+ * DFPN_MAX_EMPTY empty tiles, with DFPN_TIME_SHARE of the time.  A proven win
+ * or draw is played at once; after a proven loss the search still picks the
+ * move, hoping for a mistake
+ * Postconditions: Returns true with move = the proven move
+ */
+bool solver_move(const GameState &root, char player, SearchContext &ctx, std::pair<int, int> &move) {
+	if (!ctx.solver || !ctx.solver->enabled() || root.tiles_left > DFPN_MAX_EMPTY)
+		return false;
+	SolveResult solved = dfpn_solve(root, player, *ctx.solver, 0, ctx.time.hard_limit * DFPN_TIME_SHARE, ctx.stop);
+	ctx.stats.solved = solved.result;
+	ctx.stats.solver_nodes = solved.nodes;
+	if (solved.result != SOLVE_WIN && solved.result != SOLVE_DRAW)
+		return false;
+	ctx.pv.assign(1, solved.move);
+	ctx.score = (solved.result == SOLVE_WIN) ? SCORE_WIN : 0;
+	ctx.stats.time = ctx.time.elapsed();
+	move = solved.move;
+	return true;
+}
+
+/* Iterative deepening alpha beta search, searches depth 1, 3, 5, ... until
+ * time_limit runs out or ctx.max_depth is reached.  With ctx.threads above 1
+ * helper threads search the same position at the same time (Lazy SMP) and
+ * share what they find through the transposition table; the move is the main
+ * thread's
+ * Preconditions: root = game board, player = player to move,
+ *                ctx = time limit, m and transposition table of the search
+ * Postconditions: Returns the best move of the deepest completed iteration,
+ *                 ctx.pv is the line expected after it, starting with the
+ *                 move, and ctx.score its score; ctx.stats holds the
+ *                 statistics of the search, counts of all threads and the
+ *                 main thread's iterations
+ */
+std::pair<int, int> itr_deep_minimax(GameState root, char player, SearchContext &ctx) {
+	ctx.cutoff = false;
+	ctx.stats.clear();
+	ctx.pv.clear();
+	ctx.score = 0;
+	//history from an earlier move still helps, but counts less
+	for (int i = 0; i < MAX_BOARD_LIMIT*MAX_BOARD_LIMIT; i++)
+		ctx.history[i] /= 2;
+	if (ctx.tt)
+		ctx.tt->new_search();
+
+	//starts alphabeta algorithm with player's turn
+	//alphabeta generates every move starting with player
+	ctx.time.reset();
+	std::pair<int, int> threat;
+	if (solver_move(root, player, ctx, threat) || threat_move(root, player, ctx, threat))
+		return threat;
+	//helpers only help through the table, without one they would just
+	//compete with the main thread for the cpu
+	std::atomic<bool> stop(false);
+	std::vector<SearchContext> helper_ctx;
+	std::vector<std::thread> helpers;
+	if (ctx.tt && ctx.threads > 1) {
+		helper_ctx.assign(ctx.threads - 1, ctx);
+		for (unsigned int i = 0; i < helper_ctx.size(); i++) {
+			helper_ctx[i].thread_id = i + 1;
+			helper_ctx[i].stop = &stop;
+		}
+		for (unsigned int i = 0; i < helper_ctx.size(); i++)
+			helpers.push_back(std::thread(helper_search, root, player, &helper_ctx[i]));
+	}
+	std::pair<int, int> r_move = deepen_dispatch(root, player, ctx, 1);
+	stop.store(true, std::memory_order_relaxed);
+	for (unsigned int i = 0; i < helpers.size(); i++) {
+		helpers[i].join();
+		ctx.stats.add(helper_ctx[i].stats);
+	}
+	ctx.stats.time = ctx.time.elapsed();
+	return r_move;
+}
+//Monte Carlo tree search: a win is worth MCTS_REWARD, a draw half of it, and
+//children are picked by UCT with exploration constant MCTS_EXPLORATION
+#define MCTS_REWARD 1024
+#define MCTS_EXPLORATION 0.7
+//a leaf gets its children on its MCTS_EXPAND_VISITS-th visit
+#define MCTS_EXPAND_VISITS 2
+//progressive widening: a node visited V times picks from its first
+//MCTS_MIN_WIDTH + sqrt(V) children, which are sorted best first
+#define MCTS_MIN_WIDTH 4
+//rollouts are scored from the heuristic after this many moves, its score
+//being turned into a reward by a logistic curve of this scale
+#define MCTS_ROLLOUT_MOVES 40
+#define MCTS_EVAL_SCALE 1024.0
+//tiles tried for each rollout move that is not a win or a block
+#define MCTS_ROLLOUT_SAMPLES 3
+//least visits of a move shown in the principal variation
+#define MCTS_PV_VISITS 16
+
+//States of a tree node: no children yet, children being added by a thread,
+//children added, and no room left in the pool for its children
+#define MCTS_LEAF 0
+#define MCTS_EXPANDING 1
+#define MCTS_EXPANDED 2
+#define MCTS_FULL 3
+
+//One node of the search tree, the move that leads to it and the results of
+//the playouts through it.  reward is from the view of the player who made
+//the move
+struct MctsNode {
+	std::atomic<int> visits;
+	std::atomic<long long> reward;
+	std::atomic<int> state;
+	//children are stored next to each other in the pool
+	int first_child;
+	int child_count;
+	unsigned char row;
+	unsigned char column;
+};
+
+/* Search tree of mcts_search, kept between moves.  Nodes come from a fixed
+ * size pool, so the threads share the tree without locks: a node's children
+ * are taken from the pool in one block by an atomic add.  Node 0 is the
+ * root, the position board with player to move.
+ */
+struct MctsTree {
+	std::vector<MctsNode> nodes;
+	//first free node of the pool, never past its end
+	std::atomic<int> next;
+	GameState board;
+	char player;
+
+	MctsTree(unsigned int size_mb=0): next(0), player('X') {
+		resize(size_mb);
+	}
+
+	//size_mb of 0 leaves the pool empty, mcts_search then uses alpha beta
+	void resize(unsigned int size_mb) {
+		uint64_t count = ((uint64_t)size_mb << 20) / sizeof(MctsNode);
+		count = std::min<uint64_t>(count, 0x7FFFFFFF);
+		std::vector<MctsNode>().swap(nodes);
+		if (count > 0)
+			std::vector<MctsNode>(count).swap(nodes);
+		next.store(0);
+	}
+
+	//# of nodes in use
+	int used() const {
+		return next.load();
+	}
+
+	void reset_node(int i, int row, int column) {
+		nodes[i].visits.store(0, std::memory_order_relaxed);
+		nodes[i].reward.store(0, std::memory_order_relaxed);
+		nodes[i].state.store(MCTS_LEAF, std::memory_order_relaxed);
+		nodes[i].first_child = 0;
+		nodes[i].child_count = 0;
+		nodes[i].row = row;
+		nodes[i].column = column;
+	}
+
+	//throws the tree away and starts a new one at root_board
+	void start(const GameState &root_board, char root_player) {
+		board = root_board;
+		player = root_player;
+		reset_node(0, 0, 0);
+		next.store(1);
+	}
+
+	/* Takes count nodes from the pool.  next only moves when the nodes fit,
+	 * so failed allocations of a full pool leave it where it is
+	 * Postconditions: Returns the first of them, -1 if the pool is full
+	 */
+	int allocate(int count) {
+		int first = next.load(std::memory_order_relaxed);
+		do {
+			if (count > (int)nodes.size() - first)
+				return -1;
+		} while (!next.compare_exchange_weak(first, first + count));
+		return first;
+	}
+
+	/* Moves the root down to the node of new_board, when the tree holds the
+	 * moves played since its search, and drops the rest of the tree
+	 * Postconditions: Returns false if new_board is not in the tree, which
+	 *                 is then left as it was
+	 */
+	bool reroot(const GameState &new_board, char new_player) {
+		if (next.load() == 0 || board.n != new_board.n || board.m != new_board.m)
+			return false;
+		//the pieces played since, every old piece has to still be there
+		unsigned int played = 0;
+		for (unsigned int r = 0; r < board.n; r++) {
+			if ((board.x_rows[r] & ~new_board.x_rows[r]) || (board.o_rows[r] & ~new_board.o_rows[r]))
+				return false;
+			played += __builtin_popcount((new_board.x_rows[r] | new_board.o_rows[r])
+				& ~(board.x_rows[r] | board.o_rows[r]));
+		}
+		int node = 0;
+		char to_move = player;
+		for (; played > 0; played--) {
+			if (nodes[node].state.load() != MCTS_EXPANDED)
+				return false;
+			int found = -1;
+			for (int i = 0; i < nodes[node].child_count && found < 0; i++) {
+				const MctsNode &child = nodes[nodes[node].first_child + i];
+				if (new_board.at(child.row, child.column) == to_move)
+					found = nodes[node].first_child + i;
+			}
+			if (found < 0)
+				return false;
+			node = found;
+			to_move = (to_move == 'X') ? 'O' : 'X';
+		}
+		if (to_move != new_player)
+			return false;
+		compact(node);
+		board = new_board;
+		player = new_player;
+		return true;
+	}
+
+	/* Moves the subtree under keep to the front of the pool, with keep as
+	 * node 0.  A node is always taken from the pool after its parent, so
+	 * copying the subtree's nodes in pool order only ever moves a node down
+	 * over one that was already copied or is not kept
+	 */
+	void compact(int keep) {
+		int count = used();
+		std::vector<int> index(count, -1);
+		std::vector<int> stack(1, keep);
+		while (!stack.empty()) {
+			int node = stack.back();
+			stack.pop_back();
+			index[node] = 0;
+			if (nodes[node].state.load() == MCTS_EXPANDED) {
+				for (int i = 0; i < nodes[node].child_count; i++)
+					stack.push_back(nodes[node].first_child + i);
+			}
+		}
+		int kept = 0;
+		for (int i = 0; i < count; i++) {
+			if (index[i] >= 0)
+				index[i] = kept++;
+		}
+		for (int i = 0; i < count; i++) {
+			if (index[i] < 0)
+				continue;
+			MctsNode &to = nodes[index[i]];
+			const MctsNode &from = nodes[i];
+			int state = from.state.load();
+			to.visits.store(from.visits.load());
+			to.reward.store(from.reward.load());
+			//the pool has room again for the children of a full node
+			to.state.store(state == MCTS_FULL ? MCTS_LEAF : state);
+			to.first_child = (state == MCTS_EXPANDED) ? index[from.first_child] : 0;
+			to.child_count = (state == MCTS_EXPANDED) ? from.child_count : 0;
+			to.row = from.row;
+			to.column = from.column;
+		}
+		next.store(kept);
+	}
+};
+
+/* Gives node the moves of board as children, the thread that wins the
+ * node's state does it while the others go on to a rollout.  Only the wins
+ * or blocks are kept when there is a threat (see forced_moves), the rest
+ * are sorted by the heuristic score of the board after the move
+ * Preconditions: board = the node's position, to_move = player to move
+ * Postconditions: Returns true if this thread added the children
+ */
+template <unsigned int N, unsigned int M>
+bool mcts_expand(MctsTree &tree, int node, GameState &board, char to_move, unsigned int radius, bool root=false) {
+	int expected = MCTS_LEAF;
+	if (!tree.nodes[node].state.compare_exchange_strong(expected, MCTS_EXPANDING))
+		return false;
+	MoveList moves;
+	gen_all_moves<N>(board, moves, radius);
+	if (!forced_moves<N, M>(board, moves, to_move)) {
+		//moves to symmetric positions are only dropped at the root, below it
+		//the board is rarely symmetric
+		if (root)
+			unique_moves<N, M>(board, moves, to_move);
+		//(negated score, index), the index keeps equal scores in their order
+		std::pair<int, int> keyed[MAX_MOVES];
+		for (unsigned int i = 0; i < moves.size(); i++) {
+			MoveUndo undo = board.make_move<N, M>(moves[i].first, moves[i].second, to_move, to_move);
+			keyed[i].first = -board.hscore;
+			keyed[i].second = i;
+			board.unmake_move<N, M>(moves[i].first, moves[i].second, undo);
+		}
+		std::sort(keyed, keyed + moves.size());
+		std::pair<int, int> sorted[MAX_MOVES];
+		for (unsigned int i = 0; i < moves.size(); i++)
+			sorted[i] = moves[keyed[i].second];
+		std::copy(sorted, sorted + moves.size(), moves.moves);
+	}
+	int first = tree.allocate(moves.size());
+	if (first < 0) {
+		tree.nodes[node].state.store(MCTS_FULL);
+		return false;
+	}
+	for (unsigned int i = 0; i < moves.size(); i++)
+		tree.reset_node(first + i, moves[i].first, moves[i].second);
+	tree.nodes[node].first_child = first;
+	tree.nodes[node].child_count = moves.size();
+	tree.nodes[node].state.store(MCTS_EXPANDED, std::memory_order_release);
+	return true;
+}
+
+/* Picks the child of an expanded node to visit by UCT, among the first
+ * children allowed by progressive widening.  A child that was never visited
+ * is picked first, in the order mcts_expand sorted them
+ */
+int mcts_select(const MctsTree &tree, int node) {
+	const MctsNode &parent = tree.nodes[node];
+	int visits = std::max(parent.visits.load(std::memory_order_relaxed), 1);
+	int width = std::min(parent.child_count, MCTS_MIN_WIDTH + (int)sqrt(visits));
+	double log_visits = log(visits);
+	int best = parent.first_child;
+	double best_value = -1;
+	for (int i = 0; i < width; i++) {
+		const MctsNode &child = tree.nodes[parent.first_child + i];
+		int child_visits = child.visits.load(std::memory_order_relaxed);
+		if (child_visits == 0)
+			return parent.first_child + i;
+		double value = child.reward.load(std::memory_order_relaxed) / ((double)MCTS_REWARD * child_visits)
+			+ MCTS_EXPLORATION * sqrt(log_visits / child_visits);
+		if (value > best_value) {
+			best_value = value;
+			best = parent.first_child + i;
+		}
+	}
+	return best;
+}
+
+//finds an empty tile on the 4 lines through tile where player's piece would
+//make m in a row, false if there is none or tile is (-1, -1)
+template <unsigned int N, unsigned int M>
+bool mcts_win_tile(const GameState &board, std::pair<int, int> tile, char player, std::pair<int, int> &out) {
+	static const int steps[4][2] = {{1, 0}, {0, 1}, {-1, 1}, {1, 1}};
+	const int n = N ? N : board.n;
+	const int m = M ? M : board.m;
+	if (tile.first < 0)
+		return false;
+	for (int dir = 0; dir < 4; dir++) {
+		for (int side = -1; side <= 1; side += 2) {
+			for (int k = 1; k < m; k++) {
+				int r = tile.first + side*k*steps[dir][0];
+				int c = tile.second + side*k*steps[dir][1];
+				if (r < 0 || r >= n || c < 0 || c >= n)
+					break;
+				char piece = board.at(r, c);
+				if (piece == '.' && board.wins_at<N, M>(r, c, player)) {
+					out = std::pair<int, int>(r, c);
+					return true;
+				}
+				if (piece != '.' && piece != player)
+					break;
+			}
+		}
+	}
+	return false;
+}
+
+/* Light rollout policy for a move that is not a win or a block: tries
+ * MCTS_ROLLOUT_SAMPLES random tiles next to a piece and keeps the one the
+ * heuristic scores best for player
+ */
+template <unsigned int N, unsigned int M>
+std::pair<int, int> mcts_sample(GameState &board, char player, Xoshiro &random) {
+	const unsigned int n = N ? N : board.n;
+	uint32_t tiles[MAX_BOARD_LIMIT];
+	board.neighbors<N>(tiles);
+	unsigned int count = 0;
+	for (unsigned int r = 0; r < n; r++)
+		count += __builtin_popcount(tiles[r]);
+	//no empty tile next to a piece, any empty tile will do
+	if (count == 0) {
+		unsigned int tile = board.empty.sample(random);
+		return std::pair<int, int>(tile / MAX_BOARD_LIMIT, tile % MAX_BOARD_LIMIT);
+	}
+	std::pair<int, int> best(-1, -1);
+	int best_score = 0;
+	for (int s = 0; s < MCTS_ROLLOUT_SAMPLES; s++) {
+		unsigned int pick = random.below(count);
+		unsigned int row = 0;
+		while (pick >= (unsigned int)__builtin_popcount(tiles[row]))
+			pick -= __builtin_popcount(tiles[row++]);
+		uint32_t bits = tiles[row];
+		for (; pick > 0; pick--)
+			bits &= bits - 1;
+		unsigned int column = __builtin_ctz(bits);
+		MoveUndo undo = board.make_move<N, M>(row, column, player, player);
+		int score = board.hscore;
+		board.unmake_move<N, M>(row, column, undo);
+		if (best.first < 0 || score > best_score) {
+			best = std::pair<int, int>(row, column);
+			best_score = score;
+		}
+	}
+	return best;
+}
+
+/* Plays a game out from board: each move wins if it can, else blocks the
+ * opponent's win, else is picked by mcts_sample.  After MCTS_ROLLOUT_MOVES
+ * moves the heuristic score decides.  A new win can only be on a line
+ * through the last move of its player, so only those lines are looked at
+ * Preconditions: last = last move of X and of O, (-1, -1) if unknown
+ * Postconditions: Returns X's reward, 0 to MCTS_REWARD
+ */
+template <unsigned int N, unsigned int M>
+int mcts_rollout(GameState &board, char to_move, std::pair<int, int> last[2], Xoshiro &random,
+	unsigned long long &nodes) {
+	for (unsigned int ply = 0; ply < MCTS_ROLLOUT_MOVES; ply++) {
+		if (board.tiles_left == 0)
+			return MCTS_REWARD / 2;
+		int own = (to_move == 'X') ? 0 : 1;
+		char opponent = (to_move == 'X') ? 'O' : 'X';
+		std::pair<int, int> move;
+		if (!mcts_win_tile<N, M>(board, last[own], to_move, move)
+			&& !mcts_win_tile<N, M>(board, last[1 - own], opponent, move))
+			move = mcts_sample<N, M>(board, to_move, random);
+		board.set<N, M>(move.first, move.second, to_move);
+		board.evaluate(to_move);
+		nodes++;
+		if (board.game_end) {
+			if (board.hscore != SCORE_WIN)
+				return MCTS_REWARD / 2;
+			return (to_move == 'X') ? MCTS_REWARD : 0;
+		}
+		last[own] = move;
+		to_move = opponent;
+	}
+	return MCTS_REWARD / (1 + exp(-board.total_x / MCTS_EVAL_SCALE));
+}
+
+/* Body of a search thread, runs playouts until the time runs out or the
+ * search is stopped.  A playout walks down the tree by mcts_select, adds the
+ * children of the leaf it ends at, plays a rollout from there and adds the
+ * result to every node on the way.  Each node's visit is counted on the way
+ * down and its reward only on the way back, so until then the visit counts
+ * as a loss (a virtual loss) and other threads go down other lines
+ * Preconditions: tree's root is root, with its children
+ */
+template <unsigned int N, unsigned int M>
+void mcts_worker(MctsTree *tree, const GameState *root, char player, const SearchContext *ctx,
+	uint64_t seed, SearchStats *stats) {
+	Xoshiro random(seed);
+	char opponent = (player == 'X') ? 'O' : 'X';
+	//the opponent's last move is the last one on the root board, player's
+	//own is not known
+	std::pair<int, int> root_last(-1, -1);
+	if (root->column_mask != 0)
+		root_last = std::pair<int, int>(root->last_row, root->last_column);
+	int path[MAX_MOVES + 1];
+	while (!ctx->time.hard_expired() && !(ctx->stop && ctx->stop->load(std::memory_order_relaxed))) {
+		GameState board = *root;
+		std::pair<int, int> last[2];
+		last[player == 'X' ? 0 : 1] = std::pair<int, int>(-1, -1);
+		last[player == 'X' ? 1 : 0] = root_last;
+		char to_move = player;
+		int node = 0;
+		unsigned int length = 0;
+		path[length++] = 0;
+		tree->nodes[0].visits.fetch_add(1, std::memory_order_relaxed);
+		int reward = -1;
+		while (true) {
+			MctsNode &current = tree->nodes[node];
+			if (current.state.load(std::memory_order_acquire) != MCTS_EXPANDED
+				&& (current.visits.load(std::memory_order_relaxed) < MCTS_EXPAND_VISITS
+				|| !mcts_expand<N, M>(*tree, node, board, to_move, ctx->radius)))
+				break;
+			node = mcts_select(*tree, node);
+			MctsNode &child = tree->nodes[node];
+			child.visits.fetch_add(1, std::memory_order_relaxed);
+			path[length++] = node;
+			board.set<N, M>(child.row, child.column, to_move);
+			board.evaluate(to_move);
+			stats->nodes++;
+			last[to_move == 'X' ? 0 : 1] = std::pair<int, int>(child.row, child.column);
+			if (board.game_end) {
+				if (board.hscore != SCORE_WIN)
+					reward = MCTS_REWARD / 2;
+				else
+					reward = (to_move == 'X') ? MCTS_REWARD : 0;
+				break;
+			}
+			to_move = (to_move == 'X') ? 'O' : 'X';
 		}
+		if (reward < 0)
+			reward = mcts_rollout<N, M>(board, to_move, last, random, stats->nodes);
+		//the root's move was made by the opponent, then the players take turns
+		for (unsigned int i = 0; i < length; i++) {
+			char mover = (i % 2 == 1) ? player : opponent;
+			tree->nodes[path[i]].reward.fetch_add((mover == 'X') ? reward : MCTS_REWARD - reward,
+				std::memory_order_relaxed);
+		}
+		stats->playouts++;
+		stats->depth_reached = std::max(stats->depth_reached, length - 1);
+	}
+}
+
+//most visited child of an expanded node, the first one sorted on a tie
+int mcts_best_child(const MctsTree &tree, int node) {
+	const MctsNode &parent = tree.nodes[node];
+	int best = parent.first_child;
+	for (int i = 1; i < parent.child_count; i++) {
+		if (tree.nodes[parent.first_child + i].visits.load() > tree.nodes[best].visits.load())
+			best = parent.first_child + i;
+	}
+	return best;
+}
+
+template <unsigned int N, unsigned int M>
+std::pair<int, int> mcts_run(const GameState &root, char player, SearchContext &ctx, MctsTree &tree) {
+	GameState board = root;
+	if (tree.nodes[0].state.load() != MCTS_EXPANDED)
+		mcts_expand<N, M>(tree, 0, board, player, ctx.radius, true);
+	const MctsNode &top = tree.nodes[0];
+	//only a tree too small for the root's children gets here
+	if (top.state.load() != MCTS_EXPANDED)
+		return itr_deep_minimax(root, player, ctx);
+	//a single move, a win or the only block, is played at once
+	if (top.child_count > 1) {
+		std::vector<SearchStats> thread_stats(std::max(ctx.threads, 1u));
+		std::vector<std::thread> helpers;
+		//every thread draws its own numbers from the search's seed
+		for (unsigned int i = 1; i < thread_stats.size(); i++) {
+			helpers.push_back(std::thread(mcts_worker<N, M>, &tree, &root, player, &ctx,
+				ctx.seed + 0x9E3779B97F4A7C15ULL * i, &thread_stats[i]));
+		}
+		mcts_worker<N, M>(&tree, &root, player, &ctx, ctx.seed, &thread_stats[0]);
+		for (unsigned int i = 0; i < helpers.size(); i++)
+			helpers[i].join();
+		for (unsigned int i = 0; i < thread_stats.size(); i++) {
+			ctx.stats.add(thread_stats[i]);
+			ctx.stats.depth_reached = std::max(ctx.stats.depth_reached, thread_stats[i].depth_reached);
+		}
+	}
+	int best = mcts_best_child(tree, 0);
+	int visits = std::max(tree.nodes[best].visits.load(), 1);
+	ctx.score = tree.nodes[best].reward.load() * 1000 / ((long long)MCTS_REWARD * visits);
+	//the line of most visited moves
+	for (int node = best; ; node = mcts_best_child(tree, node)) {
+		ctx.pv.push_back(std::pair<int, int>(tree.nodes[node].row, tree.nodes[node].column));
+		if (ctx.pv.size() >= MAX_PLY || tree.nodes[node].state.load() != MCTS_EXPANDED
+			|| tree.nodes[mcts_best_child(tree, node)].visits.load() < MCTS_PV_VISITS)
+			break;
+	}
+	ctx.stats.tree_nodes = tree.used();
+	ctx.stats.time = ctx.time.elapsed();
+	if (ctx.pv_out)
+		print_pv(*ctx.pv_out, ctx, ctx.stats.depth_reached, ctx.gomocup_pv);
+	return std::pair<int, int>(tree.nodes[best].row, tree.nodes[best].column);
+}
+
+/* Monte Carlo tree search (UCT), an alternative to itr_deep_minimax for big
+ * boards and short time limits, where alpha beta does not get deep.  The
+ * part of tree that is still reachable after the moves played since its last
+ * search is kept.  With ctx.threads above 1 all threads search the one tree
+ * (see mcts_worker)
+ * Preconditions: root = game board, player = player to move, ctx = time
+ *                limit and settings of the search, tree = tree of the last
+ *                search, or an empty one
+ * Postconditions: Returns the most visited move, ctx.pv is the line of most
+ *                 visited moves from it, ctx.score its rate of reward for
+ *                 player in tenths of a percent, ctx.stats.depth_reached
+ *                 the deepest node a playout visited
+ */
+std::pair<int, int> mcts_search(const GameState &root, char player, SearchContext &ctx, MctsTree &tree) {
+	if (tree.nodes.empty())
+		return itr_deep_minimax(root, player, ctx);
+	ctx.cutoff = false;
+	ctx.stats.clear();
+	ctx.pv.clear();
+	ctx.score = 0;
+	ctx.time.reset();
+	std::pair<int, int> threat;
+	if (solver_move(root, player, ctx, threat) || threat_move(root, player, ctx, threat))
+		return threat;
+	if (!tree.reroot(root, player))
+		tree.start(root, player);
+	ctx.stats.reused_nodes = tree.used();
+	if (ctx.use_specialized && root.n == 15 && root.m == 5)
+		return mcts_run<15, 5>(root, player, ctx, tree);
+	if (ctx.use_specialized && root.n == 19 && root.m == 5)
+		return mcts_run<19, 5>(root, player, ctx, tree);
+	return mcts_run<0, 0>(root, player, ctx, tree);
+}
+
+//Default # of moves from the start of each game that --build-book keeps,
+//and least # of games a move needs to be kept
+#define BOOK_PLIES 12
+#define BOOK_MIN_GAMES 2
+
+/* Opening book file: a BookHeader, then count BookEntry records sorted by
+ * key and tile, all little endian.  key is the canonical_key of a position
+ * and tile the move played there, as row*MAX_BOARD_LIMIT+column in the
+ * canonical symmetry, with the games it was played in and the points the
+ * player who made it scored, 2 per win and 1 per draw
+ */
+struct BookHeader {
+	char magic[8];
+	uint32_t n;
+	uint32_t m;
+	uint64_t count;
+};
+
+struct BookEntry {
+	uint64_t key;
+	uint32_t tile;
+	uint32_t games;
+	uint32_t points;
+	uint32_t unused;
+};
+
+#define BOOK_MAGIC "GMKBOOK1"
+
+/* An opening book mapped read only into memory, so every engine process
+ * using the same file shares one copy of it in the page cache.  A position
+ * is looked up by binary search over the sorted entries
+ */
+struct OpeningBook {
+	void *map;
+	size_t bytes;
+	const BookHeader *header;
+	const BookEntry *entries;
+
+	OpeningBook(): map(NULL), bytes(0), header(NULL), entries(NULL) {}
+
+	~OpeningBook() {
+		close();
+	}
+
+	/* Preconditions: path = book written by --build-book
+	 * Postconditions: Returns false with error set if it cannot be read
+	 */
+	bool open(const std::string &path, std::string &error) {
+		close();
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			error = "cannot open " + path;
+			return false;
+		}
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(BookHeader)) {
+			::close(fd);
+			error = path + " is not a book";
+			return false;
+		}
+		bytes = info.st_size;
+		map = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (map == MAP_FAILED) {
+			map = NULL;
+			error = "cannot map " + path;
+			return false;
+		}
+		header = (const BookHeader *)map;
+		entries = (const BookEntry *)(header + 1);
+		if (memcmp(header->magic, BOOK_MAGIC, 8) != 0
+			|| header->count > (bytes - sizeof(BookHeader)) / sizeof(BookEntry)) {
+			close();
+			error = path + " is not a book";
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+		if (map)
+			munmap(map, bytes);
+		map = NULL;
+		header = NULL;
+		entries = NULL;
+	}
+
+	/* Looks board up in the book
+	 * Postconditions: Returns true with move = the book move of board with
+	 *                 the best score, counting one draw more than it was
+	 *                 played with so a move played once does not score 100%
+	 */
+	bool probe(const GameState &board, std::pair<int, int> &move) const {
+		if (!header || board.n != header->n || board.m != header->m)
+			return false;
+		unsigned int symmetry;
+		uint64_t key = board.canonical_key(symmetry);
+		size_t low = 0, high = header->count;
+		while (low < high) {
+			size_t middle = low + (high - low) / 2;
+			if (entries[middle].key < key)
+				low = middle + 1;
+			else
+				high = middle;
+		}
+		double best_score = -1;
+		for (size_t i = low; i < header->count && entries[i].key == key; i++) {
+			const BookEntry &entry = entries[i];
+			std::pair<int, int> tile = inverse_symmetry_tile(symmetry, board.n,
+				entry.tile / MAX_BOARD_LIMIT, entry.tile % MAX_BOARD_LIMIT);
+			double score = (entry.points + 1.0) / (2.0 * (entry.games + 1));
+			if (score > best_score && tile.first < (int)board.n && tile.second < (int)board.n
+				&& board.at(tile.first, tile.second) == '.') {
+				best_score = score;
+				move = tile;
+			}
+		}
+		return best_score >= 0;
+	}
+};
+
+//Search engines of --engine and the engine= key of --match
+#define ENGINE_ALPHABETA 0
+#define ENGINE_MCTS 1
+
+//reads an engine name, false if it is not one
+bool parse_engine(const std::string &name, unsigned int &engine) {
+	if (name == "alphabeta")
+		engine = ENGINE_ALPHABETA;
+	else if (name == "mcts")
+		engine = ENGINE_MCTS;
+	else
+		return false;
+	return true;
+}
+
+//false if player has a win or a block to make (see forced_moves) and move is
+//not one of them, so a book move never passes one up
+bool allowed_book_move(const GameState &root, char player, std::pair<int, int> move) {
+	MoveList moves;
+	gen_all_moves(root, moves);
+	if (!forced_moves(root, moves, player))
+		return true;
+	return std::find(moves.begin(), moves.end(), move) != moves.end();
+}
+
+//plays ctx.book's move when it has one, else searches root with engine; the
+//tree is only used by the MCTS engine
+std::pair<int, int> engine_search(unsigned int engine, const GameState &root, char player, SearchContext &ctx,
+                                  MctsTree &tree) {
+	std::pair<int, int> move;
+	if (ctx.book && ctx.book->probe(root, move) && allowed_book_move(root, player, move)) {
+		ctx.stats.clear();
+		ctx.stats.book_move = true;
+		ctx.pv.assign(1, move);
+		ctx.score = 0;
+		return move;
+	}
+	if (engine == ENGINE_MCTS)
+		return mcts_search(root, player, ctx, tree);
+	return itr_deep_minimax(root, player, ctx);
+}
+
+//Engine settings from the command line, used by every game mode
+struct EngineOptions {
+	//transposition table size in MB
+	unsigned int tt_mb;
+	//# of search threads
+	unsigned int threads;
+	//move generation radius
+	unsigned int radius;
+	//print the search statistics after every agent move
+	bool print_stats;
+	//file the statistics of every agent move are appended to, empty for none
+	std::string stats_json;
+	//search on the opponent's time, in human and protocol games
+	bool ponder;
+	//print the principal variation after every iteration
+	bool print_pv;
+	//ENGINE_ALPHABETA or ENGINE_MCTS
+	unsigned int engine;
+	//seed of the random player and of the searches' random numbers
+	uint64_t seed;
+	//opening book of --book, NULL for none
+	const OpeningBook *book;
+	//proof number solver table size in MB, 0 for no solver
+	unsigned int solver_mb;
+
+	EngineOptions(): tt_mb(TT_DEFAULT_MB), threads(1), radius(1), print_stats(false), ponder(false),
+		print_pv(false), engine(ENGINE_ALPHABETA), seed(0), book(NULL), solver_mb(DFPN_DEFAULT_MB) {}
+
+	//--tt MB go to the transposition table of alpha beta or to the tree of
+	//MCTS, the engine not used gets none
+	unsigned int table_mb() const {
+		return (engine == ENGINE_ALPHABETA) ? tt_mb : 0;
+	}
+
+	unsigned int tree_mb() const {
+		return (engine == ENGINE_MCTS) ? tt_mb : 0;
+	}
+
+	//pondering searches the reply alpha beta expects, MCTS keeps its tree
+	//between moves instead
+	bool ponders() const {
+		return ponder && engine == ENGINE_ALPHABETA;
+	}
+};
+
+/* Search context of an agent move with the command line settings, shared by
+ * every mode that searches with them
+ * Preconditions: move_number = # of moves played before the move,
+ *                gomocup_pv = the principal variation goes out as protocol
+ *                MESSAGE lines
+ */
+SearchContext engine_context(double time_limit, unsigned int m, TransTable &tt, DfpnTable &solver,
+                             const EngineOptions &options, unsigned int move_number, bool gomocup_pv) {
+	SearchContext ctx(time_limit, m, &tt);
+	ctx.threads = options.threads;
+	ctx.radius = options.radius;
+	ctx.seed = options.seed ^ (0x9E3779B97F4A7C15ULL * (move_number + 1));
+	ctx.book = options.book;
+	ctx.solver = &solver;
+	if (options.print_pv) {
+		ctx.pv_out = &std::cout;
+		ctx.gomocup_pv = gomocup_pv;
+	}
+	return ctx;
+}
+
+/* Prints the statistics of the agent's search and/or appends them to
+ * options.stats_json, if asked for
+ * Preconditions: move_number = # of moves played before this one
+ */
+void report_stats(const SearchStats &stats, const EngineOptions &options, unsigned int move_number,
+                  char player, std::pair<int, int> move) {
+	if (options.print_stats)
+		stats.print(std::cout);
+	if (!options.stats_json.empty()) {
+		std::ofstream json(options.stats_json.c_str(), std::ios::app);
+		if (json)
+			stats.write_json(json, move_number + 1, player, move);
+		else
+			std::cout << "Could not open " << options.stats_json << std::endl;
 	}
-	//clock_gettime(CLOCK_REALTIME, &prog_end);
-	//double time_taken = (prog_end.tv_sec - prog_start.tv_sec)+(prog_end.tv_nsec - prog_start.tv_nsec)/1000000000.0;
-	//std::cout << "TIME AT DEPTH: " << depth <<" " << time_taken << std::endl;
-	//std::cout << " start.tv_sec " << start.tv_sec << " end " << end.tv_sec << std::endl;
-	//std::cout << " start.tv_nsec " << start.tv_nsec << " end " << end.tv_nsec << std::endl;
-	//std::cout <<"  debug: best_move.first.first" << best_move.second.first <<std::endl;
-	return r_move;
 }
-void mode_one(unsigned int size, const char starting_player, const unsigned int time_limit, const unsigned int m) {
-	GameState game_board(size);
+
+/* Searches the agent's move with the command line settings and reports its
+ * search statistics
+ * Preconditions: game_board = game board, player = player to move,
+ *                move_number = # of moves played before this one
+ * Postconditions: Returns the move
+ */
+std::pair<int, int> agent_move(const GameState &game_board, char player, double time_limit, const unsigned int m,
+                               TransTable &tt, MctsTree &tree, DfpnTable &solver, const EngineOptions &options,
+                               unsigned int move_number) {
+	SearchContext ctx = engine_context(time_limit, m, tt, solver, options, move_number, false);
+	std::pair<int, int> results = engine_search(options.engine, game_board, player, ctx, tree);
+	report_stats(ctx.stats, options, move_number, player, results);
+	return results;
+}
+
+//Seconds from the start of a ponder search to where its limits start to
+//run until the reply comes in, far enough off that no iteration is skipped
+//for being predicted to run past them
+#define PONDER_TIME_LIMIT 1e7
+//least time given to a search of a move the ponder search had no move for
+#define PONDER_MIN_TIME 0.01
+
+/* Search on the opponent's time.  After the agent moves, the reply it expects
+ * (the best reply its own search found, kept in the transposition table) is
+ * played on a copy of the board and the agent's next move is searched in a
+ * background thread.  If the opponent plays that reply, the search's time
+ * limits start to run from then, so it stops as a normal search of the move
+ * would, and its result is the move; otherwise it is stopped, and only the
+ * table entries it made are kept.
+ */
+struct Ponder {
+	std::thread thread;
+	std::atomic<bool> stop;
+	std::atomic<bool> done;
+	bool active;
+	//expected reply, the board after it and the agent's search of it
+	std::pair<int, int> reply;
+	GameState board;
+	char player;
+	SearchContext ctx;
+	std::pair<int, int> result;
+	//engine_search needs a tree, alpha beta never uses it
+	MctsTree tree;
+	//monotonic_seconds() the search's limits run from, moved to the time
+	//of the reply on a hit
+	std::atomic<double> limits_from;
+
+	Ponder(): stop(false), done(false), active(false), player('X'), limits_from(0) {}
+
+	~Ponder() {
+		cancel();
+	}
+
+	static void search(Ponder *ponder) {
+		ponder->result = engine_search(ENGINE_ALPHABETA, ponder->board, ponder->player, ponder->ctx, ponder->tree);
+		ponder->done.store(true);
+	}
+
+	/* Starts pondering after the agent's move, with the search context its
+	 * next move would get from engine_context
+	 * Preconditions: game_board = board after the agent's move, player = the
+	 *                agent, time_limit = time limit of its next move, tt =
+	 *                the table the move was searched with, move_number = # of
+	 *                moves played before its next move
+	 * Postconditions: active is true if there was a reply to expect
+	 */
+	void start(const GameState &game_board, char agent, unsigned int m, double time_limit, TransTable &tt,
+	           DfpnTable &solver, const EngineOptions &options, unsigned int move_number, bool gomocup_pv) {
+		cancel();
+		if (game_board.game_end)
+			return;
+		//the agent's search stored the reply at its first ply, a min node
+		TTData data;
+		unsigned int symmetry;
+		if (!tt.probe(search_key(game_board, agent, false, symmetry), data))
+			return;
+		std::pair<int, int> move = from_table(data, game_board.n, symmetry);
+		if (move.first < 0 || move.first >= (int)game_board.n || move.second >= (int)game_board.n
+			|| game_board.at(move.first, move.second) != '.')
+			return;
+		char opponent = (agent == 'X') ? 'O' : 'X';
+		board = game_board;
+		board.set(move.first, move.second, opponent);
+		board.evaluate(agent);
+		if (board.game_end)
+			return;
+		reply = move;
+		player = agent;
+		ctx = engine_context(time_limit, m, tt, solver, options, move_number, gomocup_pv);
+		limits_from.store(monotonic_seconds() + PONDER_TIME_LIMIT);
+		ctx.time.limits_from = &limits_from;
+		ctx.stop = &stop;
+		stop.store(false);
+		done.store(false);
+		active = true;
+		thread = std::thread(search, this);
+	}
+
+	//whether game_board is the position being pondered
+	bool hit(const GameState &game_board) const {
+		return active && game_board.key == board.key;
+	}
+
+	//stops and throws away the ponder search
+	void cancel() {
+		if (!active)
+			return;
+		stop.store(true);
+		thread.join();
+		active = false;
+	}
+
+	/* On a ponder hit, starts the search's time limits, which were set to
+	 * the move's time_limit, and waits for it to stop by them, or by itself,
+	 * and returns its move.  ctx.stats covers the whole search, including the
+	 * time spent pondering
+	 * Postconditions: Returns (-1, -1) if the search was stopped before it
+	 *                 had a move, the caller then searches the move itself
+	 */
+	std::pair<int, int> finish(double time_limit) {
+		limits_from.store(monotonic_seconds());
+		TimeManager clock(time_limit);
+		while (!done.load() && !clock.hard_expired())
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		stop.store(true);
+		thread.join();
+		active = false;
+		return result;
+	}
+};
+
+void mode_one(unsigned int size, const char starting_player, const unsigned int time_limit, const unsigned int m, const EngineOptions &options) {
+	GameState game_board(size, m);
+	TransTable tt(options.table_mb());
+	MctsTree tree(options.tree_mb());
+	DfpnTable solver(options.solver_mb);
+	Ponder ponder;
 	bool player_x = true;
+	unsigned int move_number = 0;
 	std::cin.ignore();
 	while (!game_board.game_end) {
 		char cur_player;
@@ -1481,18 +5094,40 @@ void mode_one(unsigned int size, const char starting_player, const unsigned int
 			game_board = player_gen_move(game_board, cur_player, row, column);
 		}
 		else {
-			std::pair<int, int> results = itr_deep_minimax(game_board, cur_player, time_limit, m);
+			std::pair<int, int> results(-1, -1);
+			TimeManager clock(time_limit);
+			if (ponder.hit(game_board)) {
+				results = ponder.finish(time_limit);
+				if (results.first >= 0)
+					report_stats(ponder.ctx.stats, options, move_number, cur_player, results);
+			}
+			//a ponder stopped before it had a move is searched again in the
+			//time left of the move
+			if (results.first < 0) {
+				ponder.cancel();
+				double time_left = std::max(time_limit - clock.elapsed(), PONDER_MIN_TIME);
+				results = agent_move(game_board, cur_player, time_left, m, tt, tree, solver, options, move_number);
+			}
 			game_board = player_gen_move(game_board, cur_player, results.first, results.second);
 		}
 		game_board = heuristics_func(game_board, m, cur_player);
 		print_board(game_board);
 		std::cout << cur_player << "'s move: " << game_board.last_row << " " << game_board.last_column << std::endl;
+		//the agent thinks on the human's time
+		if (options.ponders() && cur_player != starting_player)
+			ponder.start(game_board, cur_player, m, time_limit, tt, solver, options, move_number + 2, false);
 		player_x = !player_x;
+		move_number++;
 	}
 }
-void mode_two(unsigned int size, const char random_player, const unsigned int time_limit, const unsigned int m){
-	GameState game_board(size);
+void mode_two(unsigned int size, const char random_player, const unsigned int time_limit, const unsigned int m, const EngineOptions &options){
+	GameState game_board(size, m);
+	TransTable tt(options.table_mb());
+	MctsTree tree(options.tree_mb());
+	DfpnTable solver(options.solver_mb);
+	Xoshiro random(options.seed);
 	bool player_x = true;
+	unsigned int move_number = 0;
 	while (!game_board.game_end) {
 		char cur_player;
 		if (player_x) {
@@ -1503,20 +5138,25 @@ void mode_two(unsigned int size, const char random_player, const unsigned int ti
 		}
 		//random moves require no minimax algorithm
 		if (cur_player == random_player)
-			game_board = random_gen_move(game_board, cur_player);
+			game_board = random_gen_move(game_board, cur_player, random);
 		else {
-			std::pair<int, int> results = itr_deep_minimax(game_board, cur_player, time_limit, m);
+			std::pair<int, int> results = agent_move(game_board, cur_player, time_limit, m, tt, tree, solver, options, move_number);
 			game_board = player_gen_move(game_board, cur_player, results.first, results.second);
 		}
 		game_board = heuristics_func(game_board, m, cur_player);
 		print_board(game_board);
 		std::cout << cur_player << "'s move: " << game_board.last_row << " " << game_board.last_column << std::endl;
 		player_x = !player_x;
+		move_number++;
 	}
 }
-void mode_three(unsigned int size, const unsigned int time_limit, const unsigned int m){
-	GameState game_board(size);
+void mode_three(unsigned int size, const unsigned int time_limit, const unsigned int m, const EngineOptions &options){
+	GameState game_board(size, m);
+	TransTable tt(options.table_mb());
+	MctsTree tree(options.tree_mb());
+	DfpnTable solver(options.solver_mb);
 	bool player_x = true;
+	unsigned int move_number = 0;
 	while (!game_board.game_end) {
 		char cur_player;
 		if (player_x) {
@@ -1525,16 +5165,1334 @@ void mode_three(unsigned int size, const unsigned int time_limit, const unsigned
 		else{
 			cur_player = 'O';
 		}
-		std::pair<int, int> results = itr_deep_minimax(game_board, cur_player, time_limit, m);
+		std::pair<int, int> results = agent_move(game_board, cur_player, time_limit, m, tt, tree, solver, options, move_number);
 		game_board = player_gen_move(game_board, cur_player, results.first, results.second);
 		game_board = heuristics_func(game_board, m, cur_player);
 		print_board(game_board);
 		std::cout << cur_player << "'s move: " << results.first << " " << results.second << std::endl;
 		player_x = !player_x;
+		move_number++;
+	}
+}
+
+//A position from the games in results.txt, moves alternate starting with X
+struct BenchPosition {
+	const char *name;
+	unsigned int size;
+	unsigned int m;
+	const char *moves;
+};
+
+const BenchPosition bench_positions[] = {
+	{"mode 1 test 2, turn 12", 19, 5, "9,9 9,8 8,8 8,7 10,9 8,9 10,10 11,11 10,7 10,8 10,11 10,12"},
+	{"mode 1 test 2, turn 24", 19, 5, "9,9 9,8 8,8 8,7 10,9 8,9 10,10 11,11 10,7 10,8 10,11 10,12 "
+		"11,9 12,9 9,11 8,12 7,7 6,6 7,11 6,11 6,12 6,9 5,13 8,10"},
+	{"mode 2 test 3, turn 8", 10, 5, "5,5 3,7 4,4 8,9 2,6 5,0 1,5 2,0"},
+	{"mode 3 test 2, turn 6", 15, 4, "7,7 6,6 5,7 6,7 6,8 6,5"},
+	{"mode 3 test 3, turn 10", 15, 4, "7,7 6,6 5,7 6,5 4,6 6,8 6,7 4,7 5,6 5,5"},
+	{"mode 3 test 3, turn 20", 15, 4, "7,7 6,6 5,7 6,5 4,6 6,8 6,7 4,7 5,6 5,5 7,6 7,8 5,8 4,9 3,5 "
+		"5,9 2,6 3,9 1,6 3,6"},
+	{"mode 3 test 4, turn 4", 5, 4, "2,2 1,1 1,2 3,2"},
+	{"mode 3 test 5, turn 2", 3, 3, "1,1 0,0"}
+};
+
+/* Plays a list of "row,column" moves separated by spaces on an empty board,
+ * starting with X
+ * Postconditions: Returns the board, player is set to the player to move
+ */
+GameState position_from_moves(unsigned int size, unsigned int m, const std::string &moves, char &player) {
+	GameState board(size, m);
+	std::stringstream ss(moves);
+	std::string token;
+	player = 'X';
+	while (ss >> token) {
+		unsigned int row, column;
+		char comma;
+		std::istringstream tile(token);
+		if (tile >> row >> comma >> column && row < size && column < size && board.at(row, column) == '.') {
+			board.set(row, column, player);
+			player = (player == 'X') ? 'O' : 'X';
+		}
+	}
+	board.evaluate(player);
+	return board;
+}
+
+//Search setups compared by run_bench
+struct BenchConfig {
+	const char *name;
+	bool use_tt;
+	bool use_ordering;
+	bool use_specialized;
+	bool use_pvs;
+	//late move reductions and the threat filter
+	bool use_pruning;
+	unsigned int radius;
+};
+
+const BenchConfig bench_configs[] = {
+	{"plain", false, false, true, false, false, 1},
+	{"table", true, false, true, false, false, 1},
+	{"table+ordering", true, true, true, false, false, 1},
+	{"table+ordering+pvs", true, true, true, true, false, 1},
+	{"table+ordering+pvs+pruning", true, true, true, true, true, 1},
+	{"table+ordering+pvs+pruning, generic engine", true, true, false, true, true, 1},
+	{"table+ordering+pvs+pruning, radius 2", true, true, true, true, true, 2}
+};
+
+/* Searches every bench position to a fixed depth with each of the bench
+ * configs, and prints node counts, times and cutoff statistics
+ */
+void run_bench(unsigned int depth, unsigned int tt_mb) {
+	unsigned int count = sizeof(bench_positions) / sizeof(bench_positions[0]);
+	const unsigned int config_count = sizeof(bench_configs) / sizeof(bench_configs[0]);
+	unsigned long long total_nodes[config_count];
+	double total_time[config_count];
+	for (unsigned int c = 0; c < config_count; c++) {
+		total_nodes[c] = 0;
+		total_time[c] = 0;
+	}
+	std::cout << "Fixed depth " << depth << " search of the results.txt positions" << std::endl;
+	for (unsigned int i = 0; i < count; i++) {
+		const BenchPosition &bench = bench_positions[i];
+		char player;
+		GameState board = position_from_moves(bench.size, bench.m, bench.moves, player);
+		std::cout << "  " << bench.name << " (" << bench.size << "x" << bench.size << ", m = "
+		          << bench.m << ", " << player << " to move)" << std::endl;
+		for (unsigned int c = 0; c < config_count; c++) {
+			const BenchConfig &config = bench_configs[c];
+			TransTable tt(config.use_tt ? tt_mb : 0);
+			SearchContext ctx(1000000, bench.m, config.use_tt ? &tt : NULL);
+			ctx.max_depth = depth;
+			ctx.use_ordering = config.use_ordering;
+			ctx.use_specialized = config.use_specialized;
+			ctx.use_pvs = config.use_pvs;
+			ctx.use_lmr = config.use_pruning;
+			ctx.use_threat_filter = config.use_pruning;
+			ctx.radius = config.radius;
+			ctx.use_tss = false;
+			TimeManager timer;
+			std::pair<int, int> move = itr_deep_minimax(board, player, ctx);
+			double time_taken = timer.elapsed();
+			total_nodes[c] += ctx.stats.nodes;
+			total_time[c] += time_taken;
+			std::cout << "    " << config.name << ": " << ctx.stats.nodes << " nodes " << time_taken
+			          << "s move " << move.first << " " << move.second << ", first move cutoffs "
+			          << 100 * ctx.stats.first_move_rate() << "%";
+			if (config.use_pvs)
+				std::cout << ", re-searches " << 100 * ctx.stats.research_rate() << "%";
+			std::cout << std::endl;
+		}
+	}
+	std::cout << "Totals:" << std::endl;
+	for (unsigned int c = 0; c < config_count; c++) {
+		std::cout << "  " << bench_configs[c].name << ": " << total_nodes[c] << " nodes "
+		          << total_time[c] << "s";
+		if (total_nodes[0] > 0)
+			std::cout << " (" << (100.0 * total_nodes[c] / total_nodes[0]) << "% of plain)";
+		std::cout << std::endl;
+	}
+}
+
+//Thread counts compared by run_smp_bench
+const unsigned int smp_bench_threads[] = {1, 2, 4, 8, 16};
+
+/* Searches every bench position to a fixed depth with 1 to 16 threads and
+ * prints the time to reach the depth, the nodes searched by all threads and
+ * the nodes per second of each thread count
+ */
+void run_smp_bench(unsigned int depth, unsigned int tt_mb) {
+	unsigned int count = sizeof(bench_positions) / sizeof(bench_positions[0]);
+	unsigned int thread_counts = sizeof(smp_bench_threads) / sizeof(smp_bench_threads[0]);
+	double base_time = 0;
+	std::cout << "Time to depth " << depth << " of the results.txt positions, "
+	          << std::thread::hardware_concurrency() << " cores" << std::endl;
+	for (unsigned int t = 0; t < thread_counts; t++) {
+		unsigned long long nodes = 0;
+		double total_time = 0;
+		for (unsigned int i = 0; i < count; i++) {
+			const BenchPosition &bench = bench_positions[i];
+			char player;
+			GameState board = position_from_moves(bench.size, bench.m, bench.moves, player);
+			TransTable tt(tt_mb);
+			SearchContext ctx(1000000, bench.m, &tt);
+			ctx.max_depth = depth;
+			ctx.use_tss = false;
+			ctx.threads = smp_bench_threads[t];
+			TimeManager timer;
+			itr_deep_minimax(board, player, ctx);
+			total_time += timer.elapsed();
+			nodes += ctx.stats.nodes;
+		}
+		if (t == 0)
+			base_time = total_time;
+		std::cout << "  " << smp_bench_threads[t] << " threads: " << total_time << "s, "
+		          << nodes << " nodes, " << (unsigned long long)(nodes / total_time)
+		          << " nodes/s, speedup " << base_time / total_time << std::endl;
+	}
+}
+
+//the kernel bench's scores are added up here, so the compiler cannot drop
+//the calls that make them as unused
+volatile long long kernel_bench_sink;
+
+/* Times heuristics_full_scan against every board kernel the cpu supports on
+ * count random 15x15 and 19x19 positions, m = 5, and checks they agree
+ */
+void run_kernel_bench(unsigned int count) {
+	std::vector<BoardKernel> kernels = board_kernels();
+	const unsigned int sizes[] = {15, 19};
+	Xoshiro random(20131107);
+	for (int s = 0; s < 2; s++) {
+		unsigned int size = sizes[s];
+		std::vector<GameState> boards;
+		for (unsigned int i = 0; i < count; i++) {
+			GameState board(size, 5);
+			//from a few pieces up to two thirds of the board
+			unsigned int pieces = 4 + random.below(size*size*2/3);
+			char player = 'X';
+			for (unsigned int k = 0; k < pieces; k++) {
+				unsigned int row = random.below(size);
+				unsigned int column = random.below(size);
+				if (board.at(row, column) != '.')
+					continue;
+				board.set(row, column, player);
+				player = (player == 'X') ? 'O' : 'X';
+			}
+			boards.push_back(board);
+		}
+		std::cout << size << "x" << size << ", " << count << " random positions" << std::endl;
+		TimeManager timer;
+		long long checksum = 0;
+		for (unsigned int i = 0; i < count; i++)
+			checksum += heuristics_full_scan(boards[i], 5, 'X').hscore;
+		double scan_time = timer.elapsed();
+		std::cout << "  heuristics_full_scan: " << scan_time * 1000000 / count << " us/position" << std::endl;
+		for (size_t k = 0; k < kernels.size(); k++) {
+			if (!kernels[k].supported) {
+				std::cout << "  " << kernels[k].name << " kernel: not supported by this cpu" << std::endl;
+				continue;
+			}
+			unsigned int mismatches = 0;
+			timer.reset();
+			for (unsigned int i = 0; i < count; i++) {
+				KernelScores scores = kernels[k].scores(boards[i]);
+				checksum += scores.score_x;
+				if (scores.score_x != boards[i].total_x || scores.score_o != boards[i].total_o)
+					mismatches++;
+			}
+			double kernel_time = timer.elapsed();
+			std::cout << "  " << kernels[k].name << " kernel: " << kernel_time * 1000000 / count
+			          << " us/position, " << scan_time / kernel_time << "x, "
+			          << mismatches << " mismatches" << std::endl;
+		}
+		kernel_bench_sink = checksum;
+	}
+}
+
+/* Runs the threat space search on a position and prints what it found,
+ * first looking for a VCF and then for a VCT
+ */
+void run_tss(unsigned int size, unsigned int m, const std::string &moves,
+	unsigned long long node_budget, double time_budget) {
+	char player;
+	GameState board = position_from_moves(size, m, moves, player);
+	print_board(board);
+	for (int vct = 0; vct < 2; vct++) {
+		TimeManager timer;
+		ThreatResult result = threat_space_search(board, player, vct == 1,
+			vct ? TSS_VCT_DEPTH : TSS_VCF_DEPTH, node_budget, time_budget);
+		double time_taken = timer.elapsed();
+		std::cout << (vct ? "VCT" : "VCF") << " for " << player << ": ";
+		if (result.found) {
+			std::cout << "win in " << (result.sequence.size()+1)/2 << " moves:";
+			for (size_t i = 0; i < result.sequence.size(); i++)
+				std::cout << " " << result.sequence[i].first << "," << result.sequence[i].second;
+		}
+		else if (result.out_of_budget)
+			std::cout << "budget ran out";
+		else
+			std::cout << "none";
+		std::cout << " (" << result.nodes << " nodes, " << time_taken << "s)" << std::endl;
+		if (result.found)
+			break;
+	}
+}
+
+/* --solve: plays the moves (X first) on an empty size x size board and
+ * solves the position for the side to move
+ */
+void run_solve(unsigned int size, unsigned int m, const std::string &moves,
+	unsigned long long node_budget, double time_budget, unsigned int solver_mb) {
+	char player;
+	GameState board = position_from_moves(size, m, moves, player);
+	print_board(board);
+	DfpnTable table(solver_mb);
+	TimeManager timer;
+	SolveResult result = dfpn_solve(board, player, table, node_budget, time_budget);
+	std::cout << player << " to move: ";
+	if (result.result == SOLVE_UNKNOWN)
+		std::cout << "budget ran out";
+	else
+		std::cout << solve_name(result.result);
+	if (result.move.first >= 0)
+		std::cout << ", playing " << result.move.first << " " << result.move.second;
+	std::cout << " (" << result.nodes << " nodes, " << timer.elapsed() << "s)" << std::endl;
+}
+
+//Largest board --solve-report solves
+#define SOLVE_REPORT_SIZE 7
+
+/* --solve-report: solves the empty board of every size from 3 to
+ * SOLVE_REPORT_SIZE and m from 3 to 5 (up to the size), each with its own
+ * table and time_budget seconds
+ */
+void run_solve_report(double time_budget, unsigned int solver_mb) {
+	for (unsigned int size = MIN_BOARD_LIMIT; size <= SOLVE_REPORT_SIZE; size++) {
+		for (unsigned int m = 3; m <= std::min(size, 5u); m++) {
+			GameState board(size, m);
+			DfpnTable table(solver_mb);
+			TimeManager timer;
+			SolveResult result = dfpn_solve(board, 'X', table, 0, time_budget);
+			std::cout << size << "x" << size << " m=" << m << ": ";
+			if (result.result == SOLVE_WIN)
+				std::cout << "X wins";
+			else if (result.result == SOLVE_DRAW)
+				std::cout << "draw";
+			else if (result.result == SOLVE_LOSS)
+				std::cout << "O wins";
+			else
+				std::cout << "not solved";
+			if (result.move.first >= 0)
+				std::cout << ", first move " << result.move.first << " " << result.move.second;
+			std::cout << " (" << result.nodes << " nodes, " << timer.elapsed() << "s)" << std::endl;
+		}
+	}
+}
+
+//Defaults of --match: random moves played before the engines take over, and
+//the table size of each engine in each game, in MB
+#define MATCH_OPENING_MOVES 4
+#define MATCH_TT_MB 16
+//random opening moves are played within this many tiles of the middle
+#define MATCH_OPENING_RADIUS 2
+//openings drawn again when one comes back with the game over, before the
+//game is skipped
+#define MATCH_OPENING_TRIES 10
+
+/* One side of a --match tournament, read from "key=value,..." on the command
+ * line.  The keys are name, engine (alphabeta or mcts), depth (0 to search
+ * until time runs out), time (seconds per move), radius, tss, ordering,
+ * specialized, pvs, lmr, filter (0 or 1), tt (MB, the tree's size for
+ * mcts), solver (MB of the proof number solver's table, 0 for none) and
+ * book (file of an opening book)
+ */
+struct EngineConfig {
+	std::string name;
+	unsigned int engine;
+	unsigned int max_depth;
+	double time_limit;
+	unsigned int radius;
+	bool use_tss;
+	bool use_ordering;
+	bool use_specialized;
+	bool use_pvs;
+	bool use_lmr;
+	bool use_threat_filter;
+	unsigned int tt_mb;
+	unsigned int solver_mb;
+	std::string book_path;
+	//the book opened from book_path by run_match
+	const OpeningBook *book;
+
+	EngineConfig(const std::string &engine_name=""): name(engine_name), engine(ENGINE_ALPHABETA), max_depth(0), time_limit(1),
+		radius(1), use_tss(true), use_ordering(true), use_specialized(true), use_pvs(true),
+		use_lmr(true), use_threat_filter(true), tt_mb(MATCH_TT_MB), solver_mb(MATCH_TT_MB), book(NULL) {}
+
+	/* Preconditions: spec = comma separated key=value settings
+	 * Postconditions: Returns false with error set on an unknown key or a
+	 *                 bad value, the settings before it are applied
+	 */
+	bool parse(const std::string &spec, std::string &error) {
+		std::stringstream ss(spec);
+		std::string setting;
+		while (std::getline(ss, setting, ',')) {
+			if (setting.empty())
+				continue;
+			size_t equals = setting.find('=');
+			std::string key = setting.substr(0, equals);
+			std::string value = (equals == std::string::npos) ? "" : setting.substr(equals + 1);
+			if (equals == std::string::npos || value.empty()) {
+				error = "missing value for " + key;
+				return false;
+			}
+			if (key == "name")
+				name = value;
+			else if (key == "engine") {
+				if (!parse_engine(value, engine)) {
+					error = "unknown engine " + value;
+					return false;
+				}
+			}
+			else if (key == "depth")
+				max_depth = atoi(value.c_str());
+			else if (key == "time")
+				time_limit = atof(value.c_str());
+			else if (key == "radius")
+				radius = atoi(value.c_str());
+			else if (key == "tss")
+				use_tss = atoi(value.c_str()) != 0;
+			else if (key == "ordering")
+				use_ordering = atoi(value.c_str()) != 0;
+			else if (key == "specialized")
+				use_specialized = atoi(value.c_str()) != 0;
+			else if (key == "pvs")
+				use_pvs = atoi(value.c_str()) != 0;
+			else if (key == "lmr")
+				use_lmr = atoi(value.c_str()) != 0;
+			else if (key == "filter")
+				use_threat_filter = atoi(value.c_str()) != 0;
+			else if (key == "tt")
+				tt_mb = atoi(value.c_str());
+			else if (key == "solver")
+				solver_mb = atoi(value.c_str());
+			else if (key == "book")
+				book_path = value;
+			else {
+				error = "unknown setting " + key;
+				return false;
+			}
+		}
+		if (radius < 1 || radius > 2) {
+			error = "radius must be 1 or 2";
+			return false;
+		}
+		if (time_limit <= 0) {
+			error = "time must be above 0";
+			return false;
+		}
+		return true;
+	}
+};
+
+//Settings of a whole --match tournament
+struct MatchSettings {
+	unsigned int games;
+	unsigned int size;
+	unsigned int m;
+	unsigned int jobs;
+	unsigned int opening_moves;
+	uint64_t seed;
+	EngineConfig engines[2];
+	//file every game's moves are written to, empty for none
+	std::string record;
+
+	MatchSettings(): games(0), size(15), m(5), jobs(1), opening_moves(MATCH_OPENING_MOVES), seed(0) {
+		engines[0] = EngineConfig("A");
+		engines[1] = EngineConfig("B");
+	}
+};
+
+//Result of one tournament game
+struct MatchGame {
+	//1 when engine A won, -1 when engine B won, 0 for a draw
+	int result;
+	//no opening left the game open, the game is not played or scored
+	bool skipped;
+	//engine that played X
+	unsigned int x_engine;
+	unsigned int moves;
+	//every move of the game, the random opening's first
+	std::vector<std::pair<int, int> > moves_played;
+	//# of moves of moves_played that are the random opening's
+	unsigned int opening_moves;
+	//search time, # of searches and the sum of their depths, per engine
+	double time[2];
+	unsigned int searches[2];
+	unsigned long long depths[2];
+
+	MatchGame(): result(0), skipped(false), x_engine(0), moves(0), opening_moves(0) {
+		for (int i = 0; i < 2; i++) {
+			time[i] = 0;
+			searches[i] = 0;
+			depths[i] = 0;
+		}
+	}
+};
+
+/* Plays random moves near the middle of an empty board, moves that end the
+ * game are skipped
+ * Preconditions: random = random number generator of the opening
+ * Postconditions: Returns the board, player is set to the player to move,
+ *                 played_moves holds the moves
+ */
+GameState random_opening(unsigned int size, unsigned int m, unsigned int moves, Xoshiro &random, char &player,
+                         std::vector<std::pair<int, int> > &played_moves) {
+	GameState board(size, m);
+	player = 'X';
+	int middle = size / 2;
+	int low = std::max(0, middle - MATCH_OPENING_RADIUS);
+	int high = std::min((int)size - 1, middle + MATCH_OPENING_RADIUS);
+	int width = high - low + 1;
+	unsigned int tries = 0;
+	for (unsigned int played = 0; played < moves && tries < 100 * moves; tries++) {
+		int row = low + random.below(width);
+		int column = low + random.below(width);
+		if (board.at(row, column) != '.')
+			continue;
+		board.set(row, column, player);
+		board.evaluate(player);
+		if (board.game_end) {
+			board.unset(row, column);
+			board.evaluate(player);
+			continue;
+		}
+		played_moves.push_back(std::pair<int, int>(row, column));
+		player = (player == 'X') ? 'O' : 'X';
+		played++;
+	}
+	return board;
+}
+
+/* Plays game number game of a tournament.  Games come in pairs with the same
+ * random opening, engine A playing X in the first of each pair and engine B in
+ * the second, so neither engine gets the better side of an opening
+ */
+MatchGame play_match_game(const MatchSettings &settings, unsigned int game) {
+	MatchGame out;
+	//both games of a pair get the opening's seed, so the same opening
+	Xoshiro random(settings.seed ^ (0x9E3779B97F4A7C15ULL * (game / 2 + 1)));
+	char player;
+	GameState board = random_opening(settings.size, settings.m, settings.opening_moves, random, player, out.moves_played);
+	for (unsigned int tries = 1; board.game_end && tries < MATCH_OPENING_TRIES; tries++) {
+		out.moves_played.clear();
+		board = random_opening(settings.size, settings.m, settings.opening_moves, random, player, out.moves_played);
+	}
+	out.x_engine = game % 2;
+	out.opening_moves = out.moves_played.size();
+	if (board.game_end) {
+		out.skipped = true;
+		return out;
+	}
+	TransTable tables[2] = {TransTable(0), TransTable(0)};
+	MctsTree trees[2];
+	DfpnTable solvers[2];
+	for (int e = 0; e < 2; e++) {
+		const EngineConfig &config = settings.engines[e];
+		tables[e].resize(config.engine == ENGINE_ALPHABETA ? config.tt_mb : 0);
+		trees[e].resize(config.engine == ENGINE_MCTS ? config.tt_mb : 0);
+		solvers[e] = DfpnTable(config.solver_mb);
+	}
+	while (!board.game_end) {
+		unsigned int engine = (player == 'X') ? out.x_engine : 1 - out.x_engine;
+		const EngineConfig &config = settings.engines[engine];
+		SearchContext ctx(config.time_limit, settings.m, config.tt_mb ? &tables[engine] : NULL);
+		ctx.max_depth = config.max_depth;
+		ctx.radius = config.radius;
+		ctx.use_tss = config.use_tss;
+		ctx.use_ordering = config.use_ordering;
+		ctx.use_specialized = config.use_specialized;
+		ctx.use_pvs = config.use_pvs;
+		ctx.use_lmr = config.use_lmr;
+		ctx.use_threat_filter = config.use_threat_filter;
+		ctx.seed = random.next();
+		ctx.book = config.book;
+		ctx.solver = &solvers[engine];
+		std::pair<int, int> move = engine_search(config.engine, board, player, ctx, trees[engine]);
+		out.time[engine] += ctx.stats.time;
+		out.searches[engine]++;
+		out.depths[engine] += ctx.stats.depth_reached;
+		//a move off the board or on a piece loses the game
+		if (move.first < 0 || move.first >= (int)settings.size || move.second < 0
+			|| move.second >= (int)settings.size || board.at(move.first, move.second) != '.') {
+			out.result = (engine == 0) ? -1 : 1;
+			return out;
+		}
+		board.set(move.first, move.second, player);
+		board.evaluate(player);
+		out.moves++;
+		out.moves_played.push_back(move);
+		if (board.game_end && board.hscore == SCORE_WIN)
+			out.result = (engine == 0) ? 1 : -1;
+		player = (player == 'X') ? 'O' : 'X';
+	}
+	return out;
+}
+
+//body of a --match thread, plays the next unplayed game until all are played
+void match_worker(const MatchSettings *settings, std::vector<MatchGame> *games,
+                  std::atomic<unsigned int> *next_game, std::mutex *print_lock) {
+	const EngineConfig *engines = settings->engines;
+	for (unsigned int game = (*next_game)++; game < settings->games; game = (*next_game)++) {
+		MatchGame result = play_match_game(*settings, game);
+		(*games)[game] = result;
+		std::lock_guard<std::mutex> lock(*print_lock);
+		std::cout << "  game " << game + 1 << ", " << engines[result.x_engine].name << " as X: ";
+		if (result.skipped) {
+			std::cout << "skipped, every opening ended the game" << std::endl;
+			continue;
+		}
+		if (result.result == 0)
+			std::cout << "draw";
+		else
+			std::cout << engines[result.result > 0 ? 0 : 1].name << " wins";
+		std::cout << " in " << result.moves << " moves" << std::endl;
+	}
+}
+
+//Elo difference of a score share, +-1000 for shares of 0 and 1
+double elo_difference(double score) {
+	if (score <= 0)
+		return -1000;
+	if (score >= 1)
+		return 1000;
+	//adding 0 turns the -0 of an even score into 0, so it is not printed as -0
+	return -400 * log10(1 / score - 1) + 0.0;
+}
+
+/* Writes the games to settings.record, one line per game: the board size,
+ * m, the winner (X, O or D for a draw), the # of random opening moves, the
+ * game's pair as seed/pair number and the moves as row,column tiles, X's
+ * first
+ */
+void write_records(const MatchSettings &settings, const std::vector<MatchGame> &games) {
+	std::ofstream out(settings.record.c_str(), std::ios::app);
+	if (!out) {
+		std::cout << "Could not open " << settings.record << std::endl;
+		return;
+	}
+	for (unsigned int g = 0; g < games.size(); g++) {
+		const MatchGame &game = games[g];
+		if (game.skipped)
+			continue;
+		char winner = 'D';
+		if (game.result != 0) {
+			unsigned int engine = (game.result > 0) ? 0 : 1;
+			winner = (engine == game.x_engine) ? 'X' : 'O';
+		}
+		out << settings.size << " " << settings.m << " " << winner << " " << game.opening_moves
+		    << " " << settings.seed << "/" << g / 2;
+		for (unsigned int i = 0; i < game.moves_played.size(); i++)
+			out << " " << game.moves_played[i].first << "," << game.moves_played[i].second;
+		out << std::endl;
+	}
+}
+
+/* Plays settings.games games between the 2 engines, settings.jobs at a time,
+ * and prints each game as it ends, then the wins, draws and losses of engine
+ * A, the Elo difference with a 95% confidence interval, and the average time
+ * and depth per move of each engine
+ */
+void run_match(const MatchSettings &settings) {
+	const EngineConfig *engines = settings.engines;
+	std::vector<MatchGame> games(settings.games);
+	std::atomic<unsigned int> next_game(0);
+	std::mutex print_lock;
+	std::cout << settings.games << " games of " << engines[0].name << " vs " << engines[1].name
+	          << ", " << settings.size << "x" << settings.size << " board, m = " << settings.m
+	          << ", " << settings.opening_moves << " random opening moves, seed " << settings.seed
+	          << ", " << settings.jobs << " games at a time" << std::endl;
+	std::vector<std::thread> workers;
+	for (unsigned int j = 0; j < settings.jobs; j++)
+		workers.push_back(std::thread(match_worker, &settings, &games, &next_game, &print_lock));
+	for (unsigned int j = 0; j < workers.size(); j++)
+		workers[j].join();
+
+	unsigned int wins = 0, draws = 0, losses = 0, skipped = 0;
+	double score_sum = 0, square_sum = 0;
+	double time[2] = {0, 0};
+	unsigned long long depths[2] = {0, 0};
+	unsigned int searches[2] = {0, 0};
+	for (unsigned int g = 0; g < games.size(); g++) {
+		const MatchGame &game = games[g];
+		if (game.skipped) {
+			skipped++;
+			continue;
+		}
+		double score = (game.result + 1) / 2.0;
+		if (game.result > 0)
+			wins++;
+		else if (game.result < 0)
+			losses++;
+		else
+			draws++;
+		score_sum += score;
+		square_sum += score * score;
+		for (int e = 0; e < 2; e++) {
+			time[e] += game.time[e];
+			depths[e] += game.depths[e];
+			searches[e] += game.searches[e];
+		}
+	}
+	unsigned int count = games.size() - skipped;
+	double mean = count ? score_sum / count : 0.5;
+	double variance = count ? std::max(square_sum / count - mean * mean, 0.0) : 0;
+	double margin = 1.96 * sqrt(variance / std::max(count, 1u));
+	double elo = elo_difference(mean);
+	double elo_low = elo_difference(mean - margin);
+	double elo_high = elo_difference(mean + margin);
+	//the interval is not symmetric around elo, so only its bounds are printed
+	std::cout << engines[0].name << " vs " << engines[1].name << ": +" << wins << " =" << draws
+	          << " -" << losses << ", score " << 100 * mean << "%, Elo " << elo << " (95%, "
+	          << elo_low << " to " << elo_high << ")";
+	if (skipped)
+		std::cout << ", " << skipped << " games skipped";
+	std::cout << std::endl;
+	for (int e = 0; e < 2; e++) {
+		std::cout << "  " << engines[e].name << ": " << (searches[e] ? time[e] / searches[e] : 0)
+		          << "s and depth " << (searches[e] ? (double)depths[e] / searches[e] : 0)
+		          << " per move, " << searches[e] << " moves" << std::endl;
+	}
+	if (!settings.record.empty())
+		write_records(settings, games);
+}
+
+//One line of a --record file
+struct GameRecord {
+	unsigned int n;
+	unsigned int m;
+	//X, O or D
+	char winner;
+	//# of random opening moves at the start of moves
+	unsigned int opening_moves;
+	//seed/pair number shared by the 2 games of an opening, empty for none
+	std::string pair;
+	std::vector<std::string> moves;
+};
+
+/* Reads a line written by write_records.  Lines without the opening and the
+ * pair, from before they were written, are read with no opening and no pair
+ * Postconditions: Returns false if the line is not a record
+ */
+bool read_record(const std::string &line, GameRecord &record) {
+	std::istringstream words(line);
+	if (!(words >> record.n >> record.m >> record.winner))
+		return false;
+	record.opening_moves = 0;
+	record.pair.clear();
+	record.moves.clear();
+	std::string word;
+	while (words >> word)
+		record.moves.push_back(word);
+	if (!record.moves.empty() && record.moves[0].find(',') == std::string::npos) {
+		if (record.moves.size() < 2)
+			return false;
+		record.opening_moves = atoi(record.moves[0].c_str());
+		record.pair = record.moves[1];
+		record.moves.erase(record.moves.begin(), record.moves.begin() + 2);
+	}
+	return true;
+}
+
+/* Counts the moves of the first plies moves of a game, or of the 2 games of
+ * an opening pair, past the random opening.  Both games of a pair start with
+ * the same opening and, as long as the engines play the same moves, the same
+ * moves after it; that shared part is counted as one game, won only when
+ * both games were won and lost only when both were lost, so min_games counts
+ * games that chose the move independently
+ */
+void count_book_games(const GameRecord *games, unsigned int count, unsigned int plies,
+                      std::map<std::pair<uint64_t, uint32_t>, BookEntry> &counts) {
+	unsigned int shared = 0;
+	if (count == 2) {
+		while (shared < games[0].moves.size() && shared < games[1].moves.size()
+			&& games[0].moves[shared] == games[1].moves[shared])
+			shared++;
+	}
+	for (unsigned int g = 0; g < count; g++) {
+		const GameRecord &record = games[g];
+		GameState board(record.n, record.m);
+		char player = 'X';
+		for (unsigned int ply = 0; ply < plies && ply < record.moves.size(); ply++) {
+			int row, column;
+			char comma;
+			std::istringstream coordinates(record.moves[ply]);
+			if (!(coordinates >> row >> comma >> column) || row < 0 || row >= (int)record.n || column < 0
+				|| column >= (int)record.n || board.at(row, column) != '.')
+				break;
+			//the second game of a pair adds nothing to the shared part
+			if (ply >= record.opening_moves && (g == 0 || ply >= shared)) {
+				unsigned int points = (record.winner == player) ? 2 : (record.winner == 'D') ? 1 : 0;
+				if (count == 2 && ply < shared) {
+					unsigned int other = (games[1].winner == player) ? 2 : (games[1].winner == 'D') ? 1 : 0;
+					points = (points + other == 0) ? 0 : (points + other == 4) ? 2 : 1;
+				}
+				unsigned int symmetry;
+				uint64_t key = board.canonical_key(symmetry);
+				std::pair<int, int> turned = symmetry_tile(symmetry, record.n, row, column);
+				uint32_t book_tile = turned.first*MAX_BOARD_LIMIT + turned.second;
+				BookEntry &entry = counts[std::make_pair(key, book_tile)];
+				entry.key = key;
+				entry.tile = book_tile;
+				entry.games++;
+				entry.points += points;
+			}
+			board.set(row, column, player);
+			player = (player == 'X') ? 'O' : 'X';
+		}
+	}
+}
+
+/* Builds an opening book from game records written by --match --record.
+ * Every move of the first plies moves of each game, past its random
+ * opening, is counted for the position it was played in, under the
+ * position's canonical key, with the result for the player who made it;
+ * moves played in fewer than min_games games are left out.  Only the games
+ * with the board size and m of the first record are used
+ */
+void build_book(const std::string &records, const std::string &book, unsigned int plies, unsigned int min_games) {
+	std::ifstream in(records.c_str());
+	if (!in) {
+		std::cout << "Could not open " << records << std::endl;
+		return;
+	}
+	std::map<std::pair<uint64_t, uint32_t>, BookEntry> counts;
+	unsigned int n = 0, m = 0;
+	unsigned int games = 0, skipped = 0;
+	//a game waiting for the other game of its pair, the next line
+	GameRecord pending[2];
+	bool waiting = false;
+	std::string line;
+	while (std::getline(in, line)) {
+		GameRecord &record = pending[waiting ? 1 : 0];
+		if (!read_record(line, record) || record.n < MIN_BOARD_LIMIT || record.n > MAX_BOARD_LIMIT
+			|| record.m < MIN_BOARD_LIMIT || (n != 0 && (record.n != n || record.m != m))) {
+			skipped++;
+			continue;
+		}
+		n = record.n;
+		m = record.m;
+		games++;
+		if (waiting && record.pair == pending[0].pair) {
+			count_book_games(pending, 2, plies, counts);
+			waiting = false;
+			continue;
+		}
+		if (waiting) {
+			count_book_games(pending, 1, plies, counts);
+			pending[0] = pending[1];
+		}
+		waiting = !pending[0].pair.empty();
+		if (!waiting)
+			count_book_games(pending, 1, plies, counts);
+	}
+	if (waiting)
+		count_book_games(pending, 1, plies, counts);
+	std::vector<BookEntry> entries;
+	for (std::map<std::pair<uint64_t, uint32_t>, BookEntry>::const_iterator it = counts.begin(); it != counts.end(); ++it) {
+		if (it->second.games >= min_games)
+			entries.push_back(it->second);
+	}
+	BookHeader header;
+	memcpy(header.magic, BOOK_MAGIC, 8);
+	header.n = n;
+	header.m = m;
+	header.count = entries.size();
+	std::ofstream out(book.c_str(), std::ios::binary);
+	out.write((const char *)&header, sizeof(header));
+	if (!entries.empty())
+		out.write((const char *)&entries[0], entries.size() * sizeof(BookEntry));
+	if (!out) {
+		std::cout << "Could not write " << book << std::endl;
+		return;
+	}
+	std::cout << games << " games (" << skipped << " lines skipped), " << counts.size() << " moves, "
+	          << entries.size() << " played in at least " << min_games << " games written to " << book << std::endl;
+}
+
+//Gomocup protocol games are five in a row
+#define PROTOCOL_M 5
+//the match time left is spent as if this many more moves were to be played
+#define PROTOCOL_MOVES_LEFT 25
+//seconds of every turn kept back for reading the board and answering
+#define PROTOCOL_TIME_MARGIN 0.05
+//least time given to a search, for timeout_turn 0 (play at once)
+#define PROTOCOL_MIN_TIME 0.01
+
+/* State of a --protocol session: the board persists between commands, and
+ * the limits from INFO are turned into a time limit per move and a table size
+ */
+struct ProtocolEngine {
+	GameState board;
+	bool started;
+	EngineOptions options;
+	TransTable tt;
+	MctsTree tree;
+	DfpnTable solver;
+	//INFO limits in seconds, 0 for no match limit, and in bytes, 0 for none
+	double timeout_turn;
+	double timeout_match;
+	double time_left;
+	uint64_t max_memory;
+	//declared after tt, so it is stopped before the table goes away
+	Ponder ponder;
+
+	ProtocolEngine(const EngineOptions &engine_options): board(0, PROTOCOL_M), started(false),
+		options(engine_options), tt(0), solver(engine_options.solver_mb), timeout_turn(30), timeout_match(0), time_left(0), max_memory(0) {}
+
+	//table size for the max_memory limit, half of it at most
+	unsigned int table_mb() const {
+		if (max_memory == 0)
+			return options.tt_mb;
+		return std::min<uint64_t>(options.tt_mb, (max_memory / 2) >> 20);
+	}
+
+	//gives the table size to the engine's table or tree
+	void resize_tables() {
+		tt.resize(options.engine == ENGINE_ALPHABETA ? table_mb() : 0);
+		tree.resize(options.engine == ENGINE_MCTS ? table_mb() : 0);
+		//solved positions are only good for one board size, and the table
+		//is only taken when a board is small enough to solve
+		solver = DfpnTable(options.solver_mb);
+	}
+
+	//seconds to search the next move for
+	double move_time() const {
+		double budget = timeout_turn;
+		if (timeout_match > 0)
+			budget = std::min(budget, time_left / PROTOCOL_MOVES_LEFT);
+		return std::max(budget - PROTOCOL_TIME_MARGIN, PROTOCOL_MIN_TIME);
+	}
+
+	void start(unsigned int size) {
+		ponder.cancel();
+		board = GameState(size, PROTOCOL_M);
+		resize_tables();
+		time_left = timeout_match;
+		started = true;
+	}
+
+	//player to move, X when an even # of pieces are on the board
+	char to_move() const {
+		return ((board.n*board.n - board.tiles_left) % 2 == 0) ? 'X' : 'O';
+	}
+
+	//reads "x,y" into (row, column), false if it is not an empty tile
+	bool read_tile(const std::string &text, int &row, int &column) const {
+		char comma;
+		std::istringstream tile(text);
+		if (!(tile >> column >> comma >> row) || comma != ',')
+			return false;
+		return row >= 0 && row < (int)board.n && column >= 0 && column < (int)board.n
+			&& board.at(row, column) == '.';
+	}
+
+	//sends the statistics of a search as a MESSAGE and/or to the JSON file
+	void report(const SearchStats &stats, char player, std::pair<int, int> move) const {
+		if (options.print_stats) {
+			std::cout << "MESSAGE depth " << stats.depth_reached << " nodes " << stats.nodes
+			          << " time " << stats.time << " nps " << (unsigned long long)stats.nps() << std::endl;
+		}
+		if (!options.stats_json.empty()) {
+			std::ofstream json(options.stats_json.c_str(), std::ios::app);
+			stats.write_json(json, board.n*board.n - board.tiles_left + 1, player, move);
+		}
+	}
+
+	//searches and plays the engine's move, and answers it as "x,y"
+	void play() {
+		char player = to_move();
+		TimeManager clock;
+		std::pair<int, int> move(-1, -1);
+		if (ponder.hit(board)) {
+			move = ponder.finish(move_time());
+			if (move.first >= 0)
+				report(ponder.ctx.stats, player, move);
+		}
+		//a ponder stopped before it had a move is searched again in the
+		//time left of the move
+		if (move.first < 0 && !board.game_end) {
+			ponder.cancel();
+			double time_limit = std::max(move_time() - clock.elapsed(), PROTOCOL_MIN_TIME);
+			SearchContext ctx = engine_context(time_limit, PROTOCOL_M, tt, solver, options,
+			                                   board.n*board.n - board.tiles_left, true);
+			move = engine_search(options.engine, board, player, ctx, tree);
+			report(ctx.stats, player, move);
+		}
+		ponder.cancel();
+		//a finished board still needs an answer, any empty tile will do
+		if (move.first < 0 || board.at(move.first, move.second) != '.') {
+			for (unsigned int i = 0; i < board.n*board.n && (move.first < 0 || board.at(move.first, move.second) != '.'); i++)
+				move = std::pair<int, int>(i / board.n, i % board.n);
+		}
+		board.set(move.first, move.second, player);
+		board.evaluate(player);
+		if (timeout_match > 0)
+			time_left = std::max(time_left - clock.elapsed(), 0.0);
+		std::cout << move.second << "," << move.first << std::endl;
+		if (options.ponders()) {
+			ponder.start(board, player, PROTOCOL_M, move_time(), tt, solver, options,
+			             board.n*board.n - board.tiles_left + 1, true);
+			if (options.print_stats && ponder.active)
+				std::cout << "MESSAGE pondering on " << ponder.reply.second << "," << ponder.reply.first << std::endl;
+		}
+	}
+
+	//handles an INFO key value line
+	void info(const std::string &key, const std::string &value) {
+		if (key == "timeout_turn")
+			timeout_turn = atof(value.c_str()) / 1000;
+		else if (key == "timeout_match") {
+			timeout_match = atof(value.c_str()) / 1000;
+			time_left = timeout_match;
+		}
+		else if (key == "time_left")
+			time_left = atof(value.c_str()) / 1000;
+		else if (key == "max_memory") {
+			max_memory = strtoull(value.c_str(), NULL, 10);
+			if (started) {
+				ponder.cancel();
+				resize_tables();
+			}
+		}
+	}
+
+	/* Reads the "x,y,field" lines of a BOARD command up to DONE, field 1
+	 * being the engine's pieces, then plays the engine's move.  The pieces
+	 * are placed after all are read, since whose is X depends on the count
+	 */
+	void read_board(std::istream &in) {
+		ponder.cancel();
+		std::vector<std::pair<std::pair<int, int>, int> > pieces;
+		std::string line;
+		bool ok = true;
+		while (std::getline(in, line)) {
+			if (!line.empty() && line[line.size()-1] == '\r')
+				line.erase(line.size()-1);
+			if (line == "DONE" || line == "done")
+				break;
+			int column, row, field;
+			char comma1, comma2;
+			std::istringstream piece(line);
+			if (piece >> column >> comma1 >> row >> comma2 >> field && row >= 0 && row < (int)board.n
+				&& column >= 0 && column < (int)board.n)
+				pieces.push_back(std::make_pair(std::make_pair(row, column), field));
+			else
+				ok = false;
+		}
+		board = GameState(board.n, PROTOCOL_M);
+		char own = (pieces.size() % 2 == 0) ? 'X' : 'O';
+		char other = (own == 'X') ? 'O' : 'X';
+		for (unsigned int i = 0; i < pieces.size(); i++) {
+			int row = pieces[i].first.first;
+			int column = pieces[i].first.second;
+			if (board.at(row, column) == '.')
+				board.set(row, column, pieces[i].second == 1 ? own : other);
+		}
+		board.evaluate(own);
+		if (!ok)
+			std::cout << "ERROR bad BOARD line" << std::endl;
+		else
+			play();
+	}
+};
+
+/* Runs the engine on stdin/stdout with the Gomocup (Piskvork) protocol:
+ * START size, RESTART, BEGIN, TURN x,y, BOARD ... DONE, TAKEBACK x,y,
+ * INFO key value, ABOUT and END.  Tiles are "x,y" with x the column
+ */
+void run_protocol(const EngineOptions &options) {
+	ProtocolEngine engine(options);
+	std::string line;
+	while (std::getline(std::cin, line)) {
+		if (!line.empty() && line[line.size()-1] == '\r')
+			line.erase(line.size()-1);
+		std::istringstream words(line);
+		std::string command;
+		words >> command;
+		for (unsigned int i = 0; i < command.size(); i++)
+			command[i] = toupper(command[i]);
+		if (command.empty())
+			continue;
+		if (command == "END")
+			return;
+		if (command == "ABOUT") {
+			std::cout << "name=\"gomoku\", version=\"1.0\", author=\"Tony Ling\", country=\"USA\"" << std::endl;
+		}
+		else if (command == "INFO") {
+			std::string key, value;
+			words >> key >> value;
+			engine.info(key, value);
+		}
+		else if (command == "START") {
+			int size = 0;
+			words >> size;
+			if (size < MIN_BOARD_LIMIT || size > MAX_BOARD_LIMIT)
+				std::cout << "ERROR unsupported size " << size << ", must be " << MIN_BOARD_LIMIT
+				          << " to " << MAX_BOARD_LIMIT << std::endl;
+			else {
+				engine.start(size);
+				std::cout << "OK" << std::endl;
+			}
+		}
+		else if (!engine.started) {
+			std::cout << "ERROR no START" << std::endl;
+		}
+		else if (command == "RESTART") {
+			engine.start(engine.board.n);
+			std::cout << "OK" << std::endl;
+		}
+		else if (command == "BEGIN") {
+			engine.play();
+		}
+		else if (command == "TURN") {
+			std::string tile;
+			int row, column;
+			words >> tile;
+			if (!engine.read_tile(tile, row, column))
+				std::cout << "ERROR bad move " << tile << std::endl;
+			else {
+				char player = engine.to_move();
+				engine.board.set(row, column, player);
+				engine.board.evaluate(player);
+				engine.play();
+			}
+		}
+		else if (command == "BOARD") {
+			engine.read_board(std::cin);
+		}
+		else if (command == "TAKEBACK") {
+			std::string tile;
+			int row, column;
+			char comma;
+			words >> tile;
+			std::istringstream coordinates(tile);
+			if (coordinates >> column >> comma >> row && row >= 0 && row < (int)engine.board.n
+				&& column >= 0 && column < (int)engine.board.n && engine.board.at(row, column) != '.') {
+				engine.ponder.cancel();
+				engine.board.unset(row, column);
+				engine.board.evaluate(engine.to_move());
+				std::cout << "OK" << std::endl;
+			}
+			else
+				std::cout << "ERROR bad TAKEBACK " << tile << std::endl;
+		}
+		else {
+			std::cout << "UNKNOWN " << command << std::endl;
+		}
 	}
 }
-int main() {
-	srand(time(NULL));
+
+//prints the command line options
+void print_usage(const char *program) {
+	std::cout << "Usage: " << program << " [--engine alphabeta|mcts] [--tt MB] [--threads N] [--radius 1|2] [--stats]\n"
+	          << "                 [--stats-json FILE] [--ponder] [--pv] [--seed S] [--book FILE] [--solver MB]\n"
+	          << "                 [--protocol]\n"
+	          << "       " << program << " [--tt MB] [--bench [depth]] [--smp-bench [depth]]\n"
+	          << "       " << program << " --kernel-bench [count]\n"
+	          << "       " << program << " --match GAMES [--size N] [--m M] [--jobs J] [--opening K] [--seed S] [--record FILE]\n"
+	          << "                 [--a \"key=value,...\"] [--b \"key=value,...\"]\n"
+	          << "       " << program << " --build-book RECORDS BOOK [--plies P] [--min-games G]\n"
+	          << "       " << program << " --tss SIZE M \"ROW,COL ...\" [--nodes N] [--seconds S]\n"
+	          << "       " << program << " [--solver MB] --solve SIZE M \"ROW,COL ...\" [--nodes N] [--seconds S]\n"
+	          << "       " << program << " [--solver MB] --solve-report [seconds]" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+	init_zobrist();
+	EngineOptions options;
+	options.seed = time(NULL);
+	OpeningBook book;
+	//a mode other than the game menu, run once every option is read so the
+	//options after it apply too, and its arguments
+	std::string mode;
+	unsigned int count = 0;
+	double seconds = 0;
+	unsigned long long node_budget = 0;
+	unsigned int position_size = 0;
+	unsigned int position_m = 0;
+	std::string position_moves;
+	std::string records;
+	std::string book_out;
+	unsigned int plies = BOOK_PLIES;
+	unsigned int min_games = BOOK_MIN_GAMES;
+	//command line options, without a mode the game menu is used
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool is_mode = arg == "--bench" || arg == "--kernel-bench" || arg == "--smp-bench" || arg == "--protocol"
+			|| arg == "--build-book" || arg == "--tss" || arg == "--solve" || arg == "--solve-report" || arg == "--match";
+		if (is_mode && !mode.empty()) {
+			std::cout << arg << ": only one of " << mode << " and " << arg << " can be run" << std::endl;
+			return 1;
+		}
+		if (arg == "--tt" && i+1 < argc) {
+			options.tt_mb = atoi(argv[++i]);
+		}
+		else if (arg == "--radius" && i+1 < argc) {
+			options.radius = atoi(argv[++i]);
+			if (options.radius < 1 || options.radius > 2) {
+				std::cout << "--radius: must be 1 or 2" << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--engine" && i+1 < argc) {
+			if (!parse_engine(argv[++i], options.engine)) {
+				std::cout << "--engine: must be alphabeta or mcts" << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--book" && i+1 < argc) {
+			std::string error;
+			if (!book.open(argv[++i], error)) {
+				std::cout << "--book: " << error << std::endl;
+				return 1;
+			}
+			options.book = &book;
+		}
+		else if (arg == "--build-book" && i+2 < argc) {
+			mode = arg;
+			records = argv[++i];
+			book_out = argv[++i];
+			for (; i+2 < argc; i += 2) {
+				std::string setting = argv[i+1];
+				if (setting == "--plies")
+					plies = atoi(argv[i+2]);
+				else if (setting == "--min-games")
+					min_games = atoi(argv[i+2]);
+				else
+					break;
+			}
+		}
+		else if (arg == "--seed" && i+1 < argc) {
+			options.seed = strtoull(argv[++i], NULL, 10);
+		}
+		else if (arg == "--solver" && i+1 < argc) {
+			options.solver_mb = atoi(argv[++i]);
+		}
+		else if (arg == "--solve-report") {
+			mode = arg;
+			seconds = 60;
+			if (i+1 < argc && argv[i+1][0] != '-')
+				seconds = atof(argv[++i]);
+		}
+		else if ((arg == "--solve" || arg == "--tss") && i+3 < argc) {
+			mode = arg;
+			seconds = (arg == "--solve") ? 60 : 10;
+			position_size = atoi(argv[++i]);
+			position_m = atoi(argv[++i]);
+			position_moves = argv[++i];
+			for (; i+2 < argc; i += 2) {
+				std::string budget = argv[i+1];
+				if (budget == "--nodes")
+					node_budget = strtoull(argv[i+2], NULL, 10);
+				else if (budget == "--seconds")
+					seconds = atof(argv[i+2]);
+				else
+					break;
+			}
+			if (position_size < MIN_BOARD_LIMIT || position_size > MAX_BOARD_LIMIT || position_m < MIN_BOARD_LIMIT) {
+				std::cout << arg << ": board size must be " << MIN_BOARD_LIMIT << " to "
+				          << MAX_BOARD_LIMIT << " and m at least " << MIN_BOARD_LIMIT << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--pv") {
+			options.print_pv = true;
+		}
+		else if (arg == "--ponder") {
+			options.ponder = true;
+		}
+		else if (arg == "--stats") {
+			options.print_stats = true;
+		}
+		else if (arg == "--stats-json" && i+1 < argc) {
+			options.stats_json = argv[++i];
+		}
+		else if (arg == "--threads" && i+1 < argc) {
+			options.threads = atoi(argv[++i]);
+			if (options.threads < 1)
+				options.threads = 1;
+		}
+		else if (arg == "--bench" || arg == "--smp-bench" || arg == "--kernel-bench") {
+			mode = arg;
+			count = (arg == "--kernel-bench") ? 10000 : 5;
+			if (i+1 < argc && argv[i+1][0] != '-')
+				count = atoi(argv[++i]);
+		}
+		else if (arg == "--protocol") {
+			mode = arg;
+		}
+		else if (arg == "--match" && i+1 < argc) {
+			//the match reads the rest of the command line, its engines are
+			//set with --a and --b instead of the options above
+			MatchSettings settings;
+			settings.games = atoi(argv[++i]);
+			settings.jobs = std::max(std::thread::hardware_concurrency(), 1u);
+			settings.seed = time(NULL);
+			std::string error;
+			for (i++; i+1 < argc && error.empty(); i += 2) {
+				std::string setting = argv[i];
+				if (setting == "--size")
+					settings.size = atoi(argv[i+1]);
+				else if (setting == "--m")
+					settings.m = atoi(argv[i+1]);
+				else if (setting == "--jobs")
+					settings.jobs = std::max(atoi(argv[i+1]), 1);
+				else if (setting == "--opening")
+					settings.opening_moves = atoi(argv[i+1]);
+				else if (setting == "--seed")
+					settings.seed = strtoull(argv[i+1], NULL, 10);
+				else if (setting == "--record")
+					settings.record = argv[i+1];
+				else if (setting == "--a" || setting == "--b") {
+					if (!settings.engines[setting == "--a" ? 0 : 1].parse(argv[i+1], error))
+						error = setting + ": " + error;
+				}
+				else
+					error = "unknown option " + setting;
+			}
+			if (i < argc && error.empty())
+				error = std::string("unknown option ") + argv[i];
+			if (!error.empty()) {
+				std::cout << "--match: " << error << std::endl;
+				return 1;
+			}
+			if (settings.size < MIN_BOARD_LIMIT || settings.size > MAX_BOARD_LIMIT || settings.m < MIN_BOARD_LIMIT) {
+				std::cout << "--match: board size must be " << MIN_BOARD_LIMIT << " to "
+				          << MAX_BOARD_LIMIT << " and m at least " << MIN_BOARD_LIMIT << std::endl;
+				return 1;
+			}
+			//one mapping of each book is shared by all the games
+			OpeningBook books[2];
+			for (int e = 0; e < 2; e++) {
+				if (settings.engines[e].book_path.empty())
+					continue;
+				if (!books[e].open(settings.engines[e].book_path, error)) {
+					std::cout << "--match: " << error << std::endl;
+					return 1;
+				}
+				settings.engines[e].book = &books[e];
+			}
+			run_match(settings);
+			return 0;
+		}
+		else {
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+	if ((mode == "--solve-report" || mode == "--solve") && options.solver_mb == 0) {
+		std::cout << mode << ": the solver needs a table, --solver above 0" << std::endl;
+		return 1;
+	}
+	if (mode == "--bench")
+		run_bench(count, options.tt_mb);
+	else if (mode == "--smp-bench")
+		run_smp_bench(count, options.tt_mb);
+	else if (mode == "--kernel-bench")
+		run_kernel_bench(count);
+	else if (mode == "--protocol")
+		run_protocol(options);
+	else if (mode == "--build-book")
+		build_book(records, book_out, plies, min_games);
+	else if (mode == "--tss")
+		run_tss(position_size, position_m, position_moves, node_budget, seconds);
+	else if (mode == "--solve")
+		run_solve(position_size, position_m, position_moves, node_budget, seconds, options.solver_mb);
+	else if (mode == "--solve-report")
+		run_solve_report(seconds, options.solver_mb);
+	if (!mode.empty())
+		return 0;
 	bool menu_ok = false;
 	unsigned int m = 3; //has to be atleast 3, problem =  if M is variable, cant use same tactics as normal gomoku, without limiting m
 	unsigned int size = 15;
@@ -1634,7 +6592,7 @@ int main() {
 				}
 			}
 		}
-		mode_one(board_size, starting_player, time_limit, matching_row);
+		mode_one(board_size, starting_player, time_limit, matching_row, options);
 	}
 	else if (game_mode == 2) {
 		bool m2_ok = false;
@@ -1671,11 +6629,11 @@ int main() {
 				}
 			}
 		}
-		mode_two(board_size, random_player, time_limit, matching_row);
+		mode_two(board_size, random_player, time_limit, matching_row, options);
 	}
 	else if (game_mode == 3) {
 		std::cout << "Mode 3 choosen." << std::endl;
-		mode_three(board_size, time_limit, matching_row);
+		mode_three(board_size, time_limit, matching_row, options);
 	}
 	else
 		std::cout << "ERROR" << std::endl;
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Takes moves back through the protocol and checks that the engine searches
+# the next turn as it would have without them: after a winning move is taken
+# back the game is not over, and after every move is taken back the board is
+# empty again.
+# Usage: tests/protocol_takeback.sh [path to the gomoku binary]
+GOMOKU=${1:-./gomoku}
+status=0
+
+out=$(printf 'START 15\nINFO timeout_turn 500\nBOARD\n0,0,1\n5,5,2\n1,0,1\n6,6,2\n2,0,1\n7,7,2\n3,0,1\n8,8,2\n4,0,1\nDONE\nTAKEBACK 4,0\nTAKEBACK 8,8\nTURN 4,0\nEND\n' \
+	| "$GOMOKU" --protocol --stats)
+move=$(echo "$out" | tail -n 1)
+if ! echo "$out" | grep -q '^MESSAGE depth'; then
+	echo "FAIL: no search after taking back a win"
+	echo "$out"
+	status=1
+elif [ "$move" != "4,4" ] && [ "$move" != "8,8" ]; then
+	echo "FAIL: played $move instead of blocking the open three"
+	echo "$out"
+	status=1
+fi
+
+out=$(printf 'START 15\nINFO timeout_turn 500\nBEGIN\nTAKEBACK 7,7\nBEGIN\nEND\n' \
+	| "$GOMOKU" --protocol)
+move=$(echo "$out" | tail -n 1)
+if [ "$move" != "7,7" ]; then
+	echo "FAIL: played $move instead of the middle on a board emptied by TAKEBACK"
+	echo "$out"
+	status=1
+fi
+
+[ $status -eq 0 ] && echo "PASS"
+exit $status